@@ -0,0 +1,368 @@
+#include "kadath_polar.hpp"
+#include "mpi.h"
+#include "magma_interface.hpp"
+#include "utils/adapt.hpp"
+#include "utils/axi_session.hpp"
+#include "utils/io_commons.hpp"
+#include "utils/manifest.hpp"
+#include "utils/newton_driver.hpp"
+#include "utils/observables.hpp"
+#include "utils/regrid.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace Kadath;
+using namespace std;
+
+// 批处理：一个进程内依次求解作业文件中的全部 (kk, omega, lambda, resol) 点。
+// MPI / MAGMA 只初始化一次；同一网格只构造一次 Space_polar，同一 (网格, kk) 只构造一次
+// Axi::Session（rsint、常量场与解析后的方程组在作业之间复用）。所有 rank 一起求解每个作业，
+// Kadath 的并行 Newton 照常跨 rank 拆分；只有 rank 0 写文件。
+//
+// adapt_rounds > 0 时每个作业收敛后按谱系数衰减调整分辨率并在新网格的槽中重解（p 自适应，见 utils/adapt.hpp）。
+//
+// 作业文件每行一个作业，# 开头为注释：
+//   kk omega lambda resol seed [output]
+// resol 为 0 时沿用种子的分辨率；seed 为解文件，或 "-" 表示上一行作业的解（在内存中传递）；
+// output 缺省为 bos_<kk>_<omega>_<lambda>.dat。
+
+struct Batch_job {
+    int line;
+    int kk;
+    double omega;
+    double lambda;
+    int resol;
+    string seed;
+    string output;
+};
+
+static vector<Batch_job> read_jobs(const string& path) {
+    ifstream in(path);
+    if (!in)
+        throw runtime_error("Cannot open job file: " + path);
+    vector<Batch_job> jobs;
+    string line;
+    int nline = 0;
+    while (getline(in, line)) {
+        nline++;
+        size_t start = line.find_first_not_of(" \t");
+        if (start == string::npos || line[start] == '#')
+            continue;
+        istringstream ss(line);
+        Batch_job job;
+        job.line = nline;
+        if (!(ss >> job.kk >> job.omega >> job.lambda >> job.resol >> job.seed))
+            throw runtime_error(path + ":" + to_string(nline) + ": expected 'kk omega lambda resol seed [output]'");
+        if (!(ss >> job.output)) {
+            char name[100];
+            sprintf(name, "bos_%d_%f_%f.dat", job.kk, job.omega, job.lambda);
+            job.output = name;
+        }
+        if (job.seed == "-" && jobs.empty())
+            throw runtime_error(path + ":" + to_string(nline) + ": the first job needs a seed file");
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+// 清单中作业的标识：由定义作业的各列组成，改过参数的行是新作业；
+// seed 为 "-" 时记上一行的输出，行序改动后接续的种子变了也视为新作业
+static string job_key(const Batch_job& job, const string& prev_output) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "kk=%d:omega=%.17g:lambda=%.17g:resol=%d", job.kk, job.omega, job.lambda, job.resol);
+    return string(buf) + ":seed=" + (job.seed == "-" ? "-" + prev_output : job.seed) + ":out=" + job.output;
+}
+
+static int resol_of(const Space_polar& space) { return space.get_domain(0)->get_nbr_points()(0); }
+
+// 一个 (网格, kk) 的持久求解槽：场、参数与会话，地址在整个批处理中不变
+struct Slot {
+    const Space_polar* space;
+    string grid;
+    int kk;
+    vector<unique_ptr<Scalar>> fields;
+    double omega = 0;
+    double lambda = 0;
+    unique_ptr<Axi::Session> session;
+
+    Slot(const Space_polar& sp, const string& key, int k, bool chord) : space(&sp), grid(key), kk(k) {
+        Scalar rsint(Axi::make_rsint(sp));
+        rsint.annule_hard();
+        fields.emplace_back(new Scalar(Regrid::std_like(sp)));
+        fields.emplace_back(new Scalar(Regrid::std_like(sp)));
+        fields.emplace_back(new Scalar(rsint));
+        fields.emplace_back(new Scalar(rsint));
+        fields.emplace_back(new Scalar(Regrid::std_like(sp, kk)));
+        session.reset(new Axi::Session(sp, kk, *fields[0], *fields[1], *fields[2], *fields[3], *fields[4],
+                                       omega, lambda));
+        if (chord)
+            session->use_chord();
+    }
+
+    // 种子场位于同一空间时直接复制，否则谱插值
+    void assign(const vector<const Scalar*>& src) {
+        for (int i = 0; i < 5; i++) {
+            if (&src[i]->get_space() == space)
+                *fields[i] = *src[i];
+            else
+                *fields[i] = Regrid::transfer(*src[i], *fields[i]);
+        }
+        Param_tensor parameters;
+        parameters.set_m_quant() = kk;
+        fields[4]->set_parameters() = parameters;
+    }
+};
+
+// 只在 rank 0 执行的写文件步骤：异常在 rank 0 捕获后广播结果，所有 rank 得到同一返回值并一起继续，
+// 不会出现 rank 0 退出而其余 rank 卡在下一个作业的集体求解中
+template <class Fn>
+static bool on_rank0(int rank, const char* what, Fn&& fn) {
+    int ok = 1;
+    if (rank == 0) {
+        try {
+            fn();
+        } catch (const exception& e) {
+            cerr << what << ": " << e.what() << endl;
+            ok = 0;
+        }
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return ok != 0;
+}
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+#ifdef ENABLE_GPU_USE
+    if (rank == 0) {
+        TESTING_CHECK(magma_init());
+        magma_print_environment();
+    }
+#endif
+
+    // 配置区域
+    int solver = 0;                                   // 0: 完整 Newton；1: 弦方法（同一槽的分解 Jacobian 跨作业复用）
+    const char* manifest_file = "batch_manifest.tsv"; // 每个作业一行记录；重跑时跳过已收敛且输出仍在的作业，空串关闭
+    double store_tol = -1;                            // >=0 时输出按谱系数截尾压缩（见 Io::save_axisymmetric），<0 完整存储
+    Io::Format store_format = Io::Format::Indexed;    // Native：不截尾时按本机字节序整块存系数
+    const char* results_file = "batch_results.csv";   // 每个收敛作业一行 Madm/Mkomar/Js/Jv 与 Newton 统计，空串关闭
+    int adapt_rounds = 0;                             // >0 时收敛后按谱系数衰减调整分辨率并重解，最多这么多轮（见 utils/adapt.hpp）
+    Adapt::Options aopts;                             // 目标截断误差 aopts.target 与分辨率范围
+    Newton::Options opts;
+    opts.prec = 1e-8;
+    opts.max_ite = 30;
+
+    if (argc < 2) {
+        if (rank == 0)
+            cerr << "Usage: batch <jobs.txt>" << endl;
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+    string job_file = argv[1];
+
+    int nfail = 0;
+    try {
+        vector<Batch_job> jobs = read_jobs(job_file);
+        Manifest::Writer manifest(manifest_file, rank);
+        Observables::Table results(results_file, rank);
+        map<string, bool> done;
+        for (const Manifest::Entry& e : Manifest::read(manifest_file))
+            done[e.scan] = e.status == "converged" && access(e.path.c_str(), R_OK) == 0;
+
+        map<string, unique_ptr<Space_polar>> grids;
+        map<string, unique_ptr<Slot>> slots;
+        auto slot_for = [&](const Space_polar& seed_space, int resol, int kk) -> Slot& {
+            int r = resol > 0 ? resol : resol_of(seed_space);
+            string key = Regrid::grid_key(seed_space, r);
+            unique_ptr<Space_polar>& grid = grids[key];
+            if (!grid)
+                grid = Regrid::with_resol(seed_space, r);
+            unique_ptr<Slot>& slot = slots[key + "#" + to_string(kk)];
+            if (!slot)
+                slot.reset(new Slot(*grid, key, kk, solver == 1));
+            return *slot;
+        };
+
+        // 上一行作业的结果：prev_slot 非空表示解仍在该槽中，否则（作业被跳过）从 prev_path 读
+        Slot* prev_slot = nullptr;
+        string prev_path;
+        bool prev_ok = false;
+
+        for (size_t n = 0; n < jobs.size(); n++) {
+            const Batch_job& job = jobs[n];
+            string scan = job_key(job, n > 0 ? jobs[n - 1].output : string());
+            if (done[scan]) {
+                if (rank == 0)
+                    cout << "Job " << n + 1 << "/" << jobs.size() << " (line " << job.line << "): already converged -> "
+                         << job.output << endl;
+                prev_slot = nullptr;
+                prev_path = job.output;
+                prev_ok = true;
+                continue;
+            }
+            double t_start = MPI_Wtime();
+            Manifest::Entry entry;
+            entry.scan = scan;
+            entry.kk = job.kk;
+            entry.omega = job.omega;
+            entry.lambda = job.lambda;
+
+            string seed = job.seed == "-" ? prev_path : job.seed;
+            if (job.seed == "-" && !prev_ok) {
+                if (rank == 0)
+                    cout << "Job " << n + 1 << "/" << jobs.size() << " (line " << job.line
+                         << "): previous job failed, skipped" << endl;
+                entry.status = "skipped";
+                on_rank0(rank, "manifest", [&] { manifest.append(entry); });
+                nfail++;
+                prev_slot = nullptr;
+                prev_ok = false;
+                continue;
+            }
+
+            // 种子读取与求解中的异常（如种子文件缺失）只使本作业失败；这些步骤所有 rank 一起执行，异常在各 rank 一致
+            Slot* slot = nullptr;
+            Newton::Report rep;
+            int total_ite = 0;
+            try {
+                if (job.seed == "-" && prev_slot) {
+                    slot = &slot_for(*prev_slot->space, job.resol, job.kk);
+                    if (slot != prev_slot) {
+                        vector<const Scalar*> src;
+                        for (const unique_ptr<Scalar>& f : prev_slot->fields)
+                            src.push_back(f.get());
+                        slot->assign(src);
+                    }
+                } else {
+                    Io::load_axisymmetric(seed.c_str(), 0.0, [&](const Space_polar& space, int, double, double,
+                                                                 const Scalar& nu, const Scalar& incA, const Scalar& incB,
+                                                                 const Scalar& incbt, const Scalar& phi, bool) {
+                        slot = &slot_for(space, job.resol, job.kk);
+                        slot->assign({&nu, &incA, &incB, &incbt, &phi});
+                    });
+                }
+                slot->omega = job.omega;
+                slot->lambda = job.lambda;
+
+                if (rank == 0)
+                    cout << "Job " << n + 1 << "/" << jobs.size() << " (line " << job.line << "): kk = " << job.kk
+                         << ", omega = " << job.omega << ", lambda = " << job.lambda
+                         << ", resol = " << resol_of(*slot->space) << ", seed = " << job.seed << endl;
+                auto progress = [&](int ite, double conv, bool ls) {
+                    if (rank == 0)
+                        cout << "Newton iteration " << ite << " " << conv << (ls ? " (line search)" : "") << endl;
+                };
+                slot->session->begin_solve();
+                rep = slot->session->solve(opts, progress);
+                total_ite = rep.ite;
+
+                // p 自适应：由各域谱系数的衰减估计所需分辨率，变化时谱插值到新网格的槽中重解；
+                // 重解失败时保留上一网格上已收敛的解
+                for (int round = 0; rep.converged() && round < adapt_rounds; round++) {
+                    vector<const Scalar*> cur;
+                    for (const unique_ptr<Scalar>& f : slot->fields)
+                        cur.push_back(f.get());
+                    Adapt::Report ar = Adapt::assess(*slot->space, cur, aopts);
+                    if (rank == 0) {
+                        cout << "Adapt round " << round + 1 << ": resol " << ar.current << " -> " << ar.resol << ", per domain:";
+                        for (size_t d = 0; d < ar.needed.size(); d++)
+                            cout << " " << ar.needed[d] << " (tail " << ar.tail[d] << ")";
+                        cout << endl;
+                    }
+                    if (!ar.changed())
+                        break;
+                    Slot* next = &slot_for(*slot->space, ar.resol, job.kk);
+                    next->assign(cur);
+                    next->omega = slot->omega;
+                    next->lambda = slot->lambda;
+                    next->session->begin_solve();
+                    Newton::Report next_rep = next->session->solve(opts, progress);
+                    total_ite += next_rep.ite;
+                    if (!next_rep.converged()) {
+                        if (rank == 0)
+                            cout << "Adapt round " << round + 1 << ": " << Newton::status_name(next_rep.status)
+                                 << " at resol " << ar.resol << ", keeping resol " << ar.current << endl;
+                        next->session->invalidate_jacobian();
+                        break;
+                    }
+                    slot = next;
+                    rep = next_rep;
+                }
+            } catch (const exception& e) {
+                if (rank == 0)
+                    cerr << "Job " << n + 1 << " (line " << job.line << "): " << e.what() << endl;
+                if (slot)
+                    slot->session->invalidate_jacobian();
+                entry.status = "error";
+                entry.wall = MPI_Wtime() - t_start;
+                on_rank0(rank, "manifest", [&] { manifest.append(entry); });
+                nfail++;
+                prev_slot = nullptr;
+                prev_ok = false;
+                continue;
+            }
+
+            entry.status = Newton::status_name(rep.status);
+            entry.ite = total_ite;
+            entry.wall = MPI_Wtime() - t_start;
+            if (rep.converged()) {
+                // 写失败时作业记为 write_failed，解仍留在槽中，后续 "-" 作业照常从内存接续
+                if (on_rank0(rank, job.output.c_str(), [&] {
+                        Io::save_axisymmetric(job.output.c_str(), *slot->space, job.kk, slot->omega, slot->lambda,
+                                              *slot->fields[0], *slot->fields[1], *slot->fields[2],
+                                              *slot->fields[3], *slot->fields[4], store_format, store_tol);
+                    }))
+                    entry.path = job.output;
+                else {
+                    entry.status = "write_failed";
+                    nfail++;
+                }
+            } else {
+                slot->session->invalidate_jacobian();
+                nfail++;
+            }
+            on_rank0(rank, "manifest", [&] { manifest.append(entry); });
+            if (!entry.path.empty())
+                on_rank0(rank, "results", [&] {
+                    if (results.enabled())
+                        results.append(scan,
+                                       Observables::axisymmetric(*slot->space, job.kk, slot->omega, slot->lambda,
+                                                                 *slot->fields[0], *slot->fields[1], *slot->fields[2],
+                                                                 *slot->fields[3], *slot->fields[4]),
+                                       total_ite, entry.wall, entry.path);
+                });
+            if (rank == 0)
+                cout << "Job " << n + 1 << ": " << entry.status << ", iterations = " << total_ite
+                     << ", residual = " << rep.conv << ", wall = " << entry.wall << " s" << endl;
+
+            prev_slot = slot;
+            prev_path = job.output;
+            prev_ok = rep.converged();
+        }
+        if (rank == 0)
+            cout << "Batch done: " << jobs.size() << " jobs, " << nfail << " failed, "
+                 << grids.size() << " grids, " << slots.size() << " sessions" << endl;
+    } catch (const exception& e) {
+        if (rank == 0)
+            cerr << "batch: " << e.what() << endl;
+        nfail = -1;
+    }
+
+#ifdef ENABLE_GPU_USE
+    if (rank == 0) {
+        TESTING_CHECK(magma_finalize());
+    }
+#endif
+    MPI_Finalize();
+    return nfail == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,356 @@
+#include "kadath_polar.hpp"
+#include "mpi.h"
+#include "utils/axi_session.hpp"
+#include "utils/io_commons.hpp"
+#include "utils/newton_driver.hpp"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace Kadath;
+using namespace std;
+
+// 集合扫描：rank 0 维护参数点队列，其余每个 rank 独立求解一个 (kk, omega, lambda) 点，
+// 初值取已收敛解中距离最近者。Kadath 的并行 Newton 固定使用 MPI_COMM_WORLD，
+// 因此各 worker 以 sequential 模式求解，不再跨 rank 拆分单个系统。
+// 每个 worker 按 (网格, kk) 保留场与 Axi::Session（方程只解析一次），种子恰为本 worker 上一个
+// 收敛点时直接从内存接续，不再读盘。
+
+static const int TAG_READY = 1;
+static const int TAG_JOB = 2;
+static const int TAG_STOP = 3;
+
+struct Job {
+    int id;
+    int kk;
+    double omega;
+    double lambda;
+    char seed[256];
+};
+
+struct Result {
+    int id;
+    int converged;
+    int status;         // Newton::Status，STATUS_ERROR / STATUS_WRITE_FAILED 见下
+    int ite;
+    double conv;
+};
+
+static const int STATUS_ERROR = -1;         // 求解中抛出异常
+static const int STATUS_WRITE_FAILED = -2;  // 已收敛但解文件写入失败
+
+struct Scan_point {
+    int kk;
+    double omega;
+    double lambda;
+    int state;          // 0: 待求解，1: 求解中，2: 已收敛，3: 失败
+    std::string path;
+};
+
+// omega / lambda 以 %.17g 写入文件名，相邻扫描点（步长可小于 1e-6）不会重名互相覆盖
+static std::string point_path(int kk, double omega, double lambda) {
+    char name[100];
+    snprintf(name, sizeof(name), "bos_%d_%.17g_%.17g.dat", kk, omega, lambda);
+    return name;
+}
+
+static const char* status_text(int status) {
+    if (status == STATUS_ERROR)
+        return "error";
+    if (status == STATUS_WRITE_FAILED)
+        return "write_failed";
+    return Newton::status_name(Newton::Status(status));
+}
+
+// 一个 (网格, kk) 的持久求解槽：场、参数与会话的地址不变，作业之间只改场值与 omega / lambda
+struct Slot {
+    std::unique_ptr<Space_polar> own;   // 旧格式种子的空间；新格式种子的空间由 Io::Space_cache 持有
+    const Space_polar* space;
+    int kk;
+    std::vector<std::unique_ptr<Scalar>> fields;
+    double omega = 0;
+    double lambda = 0;
+    std::unique_ptr<Axi::Session> session;
+
+    Slot(Io::Solution& seed, int k) : space(seed.space), kk(k) {
+        if (seed.own_space)
+            own = std::move(seed.own_space);
+        for (const std::string& name : Io::field_names(Io::SolutionKind::Axisymmetric))
+            fields.emplace_back(new Scalar(seed.field(name)));
+        set_m_quant();
+        session.reset(new Axi::Session(*space, kk, *fields[0], *fields[1], *fields[2], *fields[3], *fields[4],
+                                       omega, lambda));
+    }
+
+    // seed 的场须构造在本槽的空间上
+    void assign(const Io::Solution& seed) {
+        const std::vector<std::string>& names = Io::field_names(Io::SolutionKind::Axisymmetric);
+        for (size_t i = 0; i < names.size(); i++)
+            *fields[i] = seed.field(names[i]);
+        set_m_quant();
+    }
+
+    void set_m_quant() {
+        Param_tensor parameters;
+        parameters.set_m_quant() = kk;
+        fields[4]->set_parameters() = parameters;
+    }
+};
+
+// 一个 worker 的求解状态：按种子文件的空间块复用 Space_polar，按 (空间, kk) 复用槽；
+// last 记本 worker 上一个收敛并写盘的点，其解仍在 last_slot 中
+class Worker {
+public:
+    Worker(int max_ite, double prec) : max_ite_(max_ite), prec_(prec) {}
+
+    bool solve(const Job& job, int& status_out, int& ite_out, double& conv_out) {
+        Slot* slot = nullptr;
+        if (last_slot_ && last_ == job.seed && last_slot_->kk == job.kk) {
+            slot = last_slot_;
+        } else {
+            last_slot_ = nullptr;
+            const Space_polar* sp = spaces_.get(job.seed);
+            Io::Solution seed = Io::read_solution(job.seed, {}, sp);
+            if (seed.kind != Io::SolutionKind::Axisymmetric)
+                throw std::runtime_error(std::string("seed is not axisymmetric: ") + job.seed);
+            if (seed.kk != job.kk)
+                throw std::runtime_error("seed kk does not match the scan point");
+            if (sp) {
+                std::unique_ptr<Slot>& s = slots_[std::make_pair(sp, job.kk)];
+                if (!s)
+                    s.reset(new Slot(seed, job.kk));
+                else
+                    s->assign(seed);
+                slot = s.get();
+            } else {
+                // 旧格式种子每次自带空间，槽不复用
+                legacy_.reset(new Slot(seed, job.kk));
+                slot = legacy_.get();
+            }
+        }
+        last_slot_ = nullptr;
+        slot->omega = job.omega;
+        slot->lambda = job.lambda;
+
+        // do_newton_with_linesearch 只有默认（MPI_COMM_WORLD 上的）并行模式，worker 中不可用，
+        // 因此这里只做常规步的停滞 / 发散检测，失败状态随结果回报给 rank 0
+        Newton::Options opts;
+        opts.prec = prec_;
+        opts.max_ite = max_ite_;
+        opts.linesearch = false;
+        Newton::Report rep = Newton::run(opts,
+                                         [&](double p, double& conv) {
+                                             return slot->session->newton<Computational_model::sequential>(p, conv);
+                                         },
+                                         Newton::Linesearch());
+        ite_out = rep.ite;
+        conv_out = rep.conv;
+        status_out = int(rep.status);
+        if (!rep.converged())
+            return false;
+
+        // 写失败时该点记为失败：rank 0 不会把不存在的文件当作后续点的种子
+        std::string path = point_path(job.kk, job.omega, job.lambda);
+        try {
+            Io::save_axisymmetric(path.c_str(), *slot->space, job.kk, slot->omega, slot->lambda, *slot->fields[0],
+                                  *slot->fields[1], *slot->fields[2], *slot->fields[3], *slot->fields[4]);
+        } catch (const std::exception& e) {
+            cerr << path << ": " << e.what() << endl;
+            status_out = STATUS_WRITE_FAILED;
+            return false;
+        }
+        last_ = path;
+        last_slot_ = slot;
+        return true;
+    }
+
+private:
+    int max_ite_;
+    double prec_;
+    Io::Space_cache spaces_;
+    std::map<std::pair<const Space_polar*, int>, std::unique_ptr<Slot>> slots_;
+    std::unique_ptr<Slot> legacy_;
+    std::string last_;
+    Slot* last_slot_ = nullptr;
+};
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    int rank = 0;
+    int nproc = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+
+    // 配置区域：种子解与扫描网格
+    std::vector<std::string> seeds = {"bosinit.dat"}; // 已收敛的初始解（可多个）
+    std::vector<int> kk_list = {1};
+    double omega_max = 0.80;      // omega 网格：omega_max 向下 n_omega 个点
+    double omega_step = 0.003;
+    int n_omega = 32;
+    std::vector<double> lambda_list = {0.0};
+    double lambda_weight = 0.01;  // 最近邻距离中 lambda 相对 omega 的权重
+    int max_ite = 20;             // 单点 Newton 迭代上限
+    double prec = 1e-8;
+
+    int exit_code = 0;
+    Worker worker(max_ite, prec);
+    if (rank == 0) {
+        std::vector<Scan_point> points;
+        for (const std::string& seed : seeds) {
+            int kk_guess = 0;
+            if (Io::detect_kind(seed.c_str(), kk_guess) != Io::SolutionKind::Axisymmetric)
+                continue;
+            Io::load_axisymmetric(seed.c_str(), 0.0, [&](const Space_polar&, int kk, double omega, double lambda,
+                                                         const Scalar&, const Scalar&, const Scalar&,
+                                                         const Scalar&, const Scalar&, bool) {
+                points.push_back({kk, omega, lambda, 2, seed});
+            });
+        }
+        size_t nseeds = points.size();
+        for (int kk : kk_list)
+            for (double lambda : lambda_list)
+                for (int i = 0; i < n_omega; i++)
+                    points.push_back({kk, omega_max - i * omega_step, lambda, 0, ""});
+        cout << "Ensemble scan: " << points.size() - nseeds << " points, "
+             << nseeds << " seeds, " << (nproc > 1 ? nproc - 1 : 1) << " workers" << endl;
+
+        // 在待求解点中选择离已收敛集合最近的点，返回其下标与种子下标
+        auto next_job = [&](int& seed_idx) {
+            int best = -1;
+            double best_dist = 0;
+            for (size_t i = 0; i < points.size(); i++) {
+                if (points[i].state != 0)
+                    continue;
+                for (size_t j = 0; j < points.size(); j++) {
+                    if (points[j].state != 2 || points[j].kk != points[i].kk)
+                        continue;
+                    double dom = points[i].omega - points[j].omega;
+                    double dla = (points[i].lambda - points[j].lambda) * lambda_weight;
+                    double dist = dom * dom + dla * dla;
+                    if (best < 0 || dist < best_dist) {
+                        best = int(i);
+                        best_dist = dist;
+                        seed_idx = int(j);
+                    }
+                }
+            }
+            return best;
+        };
+
+        auto make_job = [&](int idx, int seed_idx) {
+            Job job;
+            job.id = idx;
+            job.kk = points[idx].kk;
+            job.omega = points[idx].omega;
+            job.lambda = points[idx].lambda;
+            strncpy(job.seed, points[seed_idx].path.c_str(), sizeof(job.seed) - 1);
+            job.seed[sizeof(job.seed) - 1] = '\0';
+            points[idx].state = 1;
+            return job;
+        };
+
+        auto record = [&](const Result& res) {
+            if (res.id < 0)
+                return;
+            Scan_point& p = points[res.id];
+            p.state = res.converged ? 2 : 3;
+            if (res.converged)
+                p.path = point_path(p.kk, p.omega, p.lambda);
+            cout << (res.converged ? "converged" : "FAILED   ")
+                 << " kk=" << p.kk << " omega=" << p.omega << " lambda=" << p.lambda
+                 << " ite=" << res.ite << " conv=" << res.conv
+                 << " status=" << status_text(res.status) << endl;
+        };
+
+        if (nproc == 1) {
+            int seed_idx = 0;
+            int idx;
+            while ((idx = next_job(seed_idx)) >= 0) {
+                Job job = make_job(idx, seed_idx);
+                Result res{job.id, 0, 0, 0, 0};
+                try {
+                    res.converged = worker.solve(job, res.status, res.ite, res.conv);
+                } catch (const std::exception& e) {
+                    cerr << "rank " << rank << ": " << e.what() << endl;
+                    res.converged = 0;
+                    res.status = STATUS_ERROR;
+                }
+                record(res);
+            }
+        } else {
+            // 当前无可分配点但仍有点在求解中时，worker 暂存等待
+            std::vector<int> idle;
+            int busy = 0;
+            int active = nproc - 1;
+            while (active > 0) {
+                Result res;
+                MPI_Status status;
+                MPI_Recv(&res, sizeof(Result), MPI_BYTE, MPI_ANY_SOURCE, TAG_READY, MPI_COMM_WORLD, &status);
+                if (res.id >= 0)
+                    busy--;
+                record(res);
+                idle.push_back(status.MPI_SOURCE);
+
+                int seed_idx = 0;
+                int idx;
+                while (!idle.empty() && (idx = next_job(seed_idx)) >= 0) {
+                    Job job = make_job(idx, seed_idx);
+                    MPI_Send(&job, sizeof(Job), MPI_BYTE, idle.back(), TAG_JOB, MPI_COMM_WORLD);
+                    idle.pop_back();
+                    busy++;
+                }
+                if (busy == 0) {
+                    for (int w : idle) {
+                        Job stop;
+                        stop.id = -1;
+                        MPI_Send(&stop, sizeof(Job), MPI_BYTE, w, TAG_STOP, MPI_COMM_WORLD);
+                        active--;
+                    }
+                    idle.clear();
+                }
+            }
+        }
+
+        int nconv = 0;
+        int nfail = 0;
+        for (size_t i = nseeds; i < points.size(); i++) {
+            nconv += points[i].state == 2;
+            nfail += points[i].state == 3;
+        }
+        int nleft = int(points.size() - nseeds) - nconv - nfail;
+        cout << "Ensemble done: " << nconv << " converged, " << nfail << " failed, "
+             << nleft << " unreachable" << endl;
+        // 只由 rank 0 决定退出码：有点失败或不可达时非零，mpirun 随之返回非零
+        exit_code = nfail + nleft > 0 ? 1 : 0;
+    } else {
+        Result res{-1, 0, 0, 0, 0};
+        while (true) {
+            MPI_Send(&res, sizeof(Result), MPI_BYTE, 0, TAG_READY, MPI_COMM_WORLD);
+            Job job;
+            MPI_Status status;
+            MPI_Recv(&job, sizeof(Job), MPI_BYTE, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+            if (status.MPI_TAG == TAG_STOP)
+                break;
+            res.id = job.id;
+            res.ite = 0;
+            res.conv = 0;
+            res.status = 0;
+            try {
+                res.converged = worker.solve(job, res.status, res.ite, res.conv);
+            } catch (const std::exception& e) {
+                cerr << "rank " << rank << ": " << e.what() << endl;
+                res.converged = 0;
+                res.status = STATUS_ERROR;
+            }
+        }
+    }
+
+    MPI_Finalize();
+    return exit_code;
+}
@@ -1,10 +1,43 @@
 #include "kadath_polar.hpp"
 #include "mpi.h"
 #include "magma_interface.hpp"
+#include "utils/axi_session.hpp"
+#include "utils/predictor.hpp"
+#include "utils/newton_driver.hpp"
+#include "utils/axi_jfnk.hpp"
+#include "utils/manifest.hpp"
+#include "utils/io_commons.hpp"
+#include "utils/bundle.hpp"
+#include "utils/async_writer.hpp"
+#include "utils/observables.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
 
 
 using namespace Kadath ;
 
+// 只在 rank 0 执行的写文件步骤：异常在 rank 0 捕获后广播结果，各 rank 一起继续扫描，
+// 不会出现 rank 0 退出而其余 rank 卡在下一点的集体求解中
+template <class Fn>
+static bool on_rank0 (int rank, const char* what, Fn&& fn) {
+	int ok = 1 ;
+	if (rank==0) {
+		try {
+			fn() ;
+		}
+		catch (const std::exception& e) {
+			cerr << what << ": " << e.what() << endl ;
+			ok = 0 ;
+		}
+	}
+	MPI_Bcast (&ok, 1, MPI_INT, 0, MPI_COMM_WORLD) ;
+	return ok!=0 ;
+}
+
 int main(int argc, char** argv) {
 
 	int rc = MPI_Init(&argc, &argv) ;
@@ -24,6 +57,23 @@ int main(int argc, char** argv) {
 	int tar = 0;            // 0: 扫 omega；1: 扫 lambda
 	double step = 0.003;    // 每步增量（tar=1 默认可按需改为 1.0）
 	int number = 8;         // 迭代步数
+	int mode = 0;           // 0: 固定步长（ome 为常数）；1: 伪弧长延拓（ome 为未知量，仅 tar=0）
+	double arc_r = 2.5;     // 弧长约束的监测点：赤道面上的半径
+	int max_ite = 20;       // 单点 Newton 迭代上限，超过视为失败
+	int max_retry = 6;      // 单点失败后最多缩步重试次数（每次步长减半）
+	int fast_ite = 4;       // 迭代数不超过此值时放大步长
+	int slow_ite = 8;       // 迭代数不少于此值时缩小步长
+	double step_grow = 1.5; // 放大倍数（固定步长模式下不超过初始步长的 4 倍）
+	int pred_order = 2;     // 初值外推的多项式阶数（0: 直接沿用上一解）
+	int solver = 0;         // 0: 每步完整 Newton；1: 弦方法（复用分解的 Jacobian，Broyden 修正）；2: JFNK（不装配细网格 Jacobian）
+	int jfnk_coarse = 9;    // solver=2 时预条件子所用粗网格分辨率
+	bool linesearch = true; // 常规 Newton 失败后先以带线搜索的阻尼 Newton 重试，再缩步
+	const char* manifest_file = "msol_manifest.tsv"; // 扫描清单（只追加），重启时跳过已收敛的点；空串关闭
+	double store_tol = -1;  // >=0 时解文件按谱系数截尾压缩（阈值相对每个场每个域的最大系数），<0 完整存储
+	Io::Format store_format = Io::Format::Indexed;  // Native：不截尾时按本机字节序整块存系数（读写免逐个字节翻转）
+	const char* bundle_file = "";  // 非空时收敛点依次追加到该 bundle（网格只存一次、store_tol>=0 时相邻点存差值、按参数精确索引），不再写单独的 bos_*.dat
+	bool async_write = true;       // rank 0 序列化到内存后由后台线程写 bos_*.dat（临时文件 + rename），下一点的 Newton 不等磁盘
+	const char* results_file = "msol_results.csv"; // 每个收敛点一行 Madm/Mkomar/Js/Jv 与 Newton 统计（收敛后由内存中的场直接计算）；空串关闭
 
 	if (tar==1 && number==8 && step==0.003) {
 		// 若切换到 lambda 扫描但未改参数，采用更合理的默认值
@@ -35,25 +85,19 @@ int main(int argc, char** argv) {
 	double omega ;
 	double lambda = 0;
 
-	FILE* fin = fopen (input_file, "r") ;
-	Space_polar space(fin) ;
-	fread_be (&kk, sizeof(int), 1, fin) ;
-	fread_be (&omega, sizeof(double), 1, fin) ;
-	if (fread_be (&lambda, sizeof(double), 1, fin) != 1) {
-		lambda = 0.0; // 旧格式无 lambda
-	}
-	Scalar nu (space,fin) ;
-	Scalar incA (space, fin) ;
-	Scalar incB (space, fin) ;
-	Scalar incbt (space, fin) ;
-	Scalar phi (space, fin) ;
-	fclose(fin) ;
+	// 新旧格式均可（旧格式无 lambda 时取 0）
+	Io::Solution init = Io::read_solution (input_file) ;
+	const Space_polar& space = *init.space ;
+	kk = init.kk ;
+	omega = init.omega ;
+	lambda = init.lambda ;
+	Scalar nu (init.field("nu")) ;
+	Scalar incA (init.field("incA")) ;
+	Scalar incB (init.field("incB")) ;
+	Scalar incbt (init.field("incbt")) ;
+	Scalar phi (init.field("phi")) ;
 
 	
-	int ndom = space.get_nbr_domains() ;
-	double qpi = 4*M_PI ;
-
-
 	Param_tensor parameters ;
 	parameters.set_m_quant() = kk ;
         phi.set_parameters() = parameters ;
@@ -61,123 +105,366 @@ int main(int argc, char** argv) {
 	// 手动配置：不从命令行读取 tar/step/number
 	if (tar!=0 && tar!=1) tar=0;
 	if (tar==1 && number==8 && step==0.003) { number = 2; step = 1.0; }
+	if (mode!=0 && tar!=0) {
+		if (rank==0)
+			cout << "Arclength mode only applies to the omega scan, using fixed steps" << endl ;
+		mode = 0 ;
+	}
+
+	// 伪弧长：前两点按固定步长求解，之后用最近两个收敛解的割线作为切向量，
+	// 场矢量取五个场在监测点 Mc 上的值，与 ome 一起构成约束
+	Point Mc (2) ;
+	Mc.set(1) = arc_r ;
+	Mc.set(2) = 0 ;
+	double tang[6] = {0, 0, 0, 0, 0, 0} ;
+	double xc[6] = {0, 0, 0, 0, 0, 0} ;
+	double ds = 0 ;
+	double arc_step = 0 ;
+	double cur_step = step ;
+
+	// 最近两个收敛解：失败时从 last 重新出发，prev 用于割线
+	Scalar nu_last (nu) ;
+	Scalar incA_last (incA) ;
+	Scalar incB_last (incB) ;
+	Scalar incbt_last (incbt) ;
+	Scalar phi_last (phi) ;
+	double omega_last = omega ;
+	double lambda_last = lambda ;
+	Scalar nu_prev (nu) ;
+	Scalar incA_prev (incA) ;
+	Scalar incB_prev (incB) ;
+	Scalar incbt_prev (incbt) ;
+	Scalar phi_prev (phi) ;
+	double omega_prev = omega ;
+
+	Cont::Predictor predictor (pred_order) ;
+	double s_last = 0 ;
 
-	for (int kant=0 ; kant<number ; kant++) {
+	// 方程只解析一次：固定 ome 的会话与弧长会话共享同一组场
+	Axi::Session fixed (space, kk, nu, incA, incB, incbt, phi, omega, lambda) ;
+	Axi::Session arc (space, kk, nu, incA, incB, incbt, phi, omega, lambda, true) ;
+	arc.add_parameter ("tnu", tang[0]) ;
+	arc.add_parameter ("tincA", tang[1]) ;
+	arc.add_parameter ("tincB", tang[2]) ;
+	arc.add_parameter ("tincbt", tang[3]) ;
+	arc.add_parameter ("tphi", tang[4]) ;
+	arc.add_parameter ("tome", tang[5]) ;
+	arc.add_parameter ("nuc", xc[0]) ;
+	arc.add_parameter ("incAc", xc[1]) ;
+	arc.add_parameter ("incBc", xc[2]) ;
+	arc.add_parameter ("incbtc", xc[3]) ;
+	arc.add_parameter ("phic", xc[4]) ;
+	arc.add_parameter ("omec", xc[5]) ;
+	arc.add_parameter ("arcds", ds) ;
+	if (solver==1) {
+		fixed.use_chord() ;
+		arc.use_chord() ;
+	}
+	arc.add_point_constraint (Mc, "tnu*(nu-nuc) + tincA*(incA-incAc) + tincB*(incB-incBc) + tincbt*(incbt-incbtc) + tphi*(phi-phic) + tome*(ome-omec) - arcds") ;
+
+	Newton::Options nopts ;
+	nopts.prec = 1e-8 ;
+	nopts.max_ite = max_ite ;
+	nopts.linesearch = linesearch && solver!=2 ;	// 线搜索回退需要装配完整 Jacobian
+
+	// JFNK：两个会话各自带一个粗网格镜像作为预条件子
+	std::unique_ptr<Axi::Jfnk_solver> jfnk_fixed ;
+	std::unique_ptr<Axi::Jfnk_solver> jfnk_arc ;
+	if (solver==2) {
+		Jfnk::Options jopts ;
+		jopts.resol_coarse = jfnk_coarse ;
+		jfnk_fixed.reset (new Axi::Jfnk_solver(fixed, jopts)) ;
+		if (mode==1)
+			jfnk_arc.reset (new Axi::Jfnk_solver(arc, jopts)) ;
+	}
+
+	int kant = 0 ;
+	int retry = 0 ;
+
+	// 记下一个收敛点：更新外推历史与最近两个收敛解
+	auto remember = [&] () {
+		// 弧长模式的外推参数为监测点坐标下的累计弦长
+		double s_cur = (tar==0) ? omega : lambda ;
+		if (mode==1) {
+			s_cur = s_last ;
+			if (kant!=0) {
+				double chord = pow(nu.val_point(Mc)-nu_last.val_point(Mc), 2) + pow(incA.val_point(Mc)-incA_last.val_point(Mc), 2)
+					+ pow(incB.val_point(Mc)-incB_last.val_point(Mc), 2) + pow(incbt.val_point(Mc)-incbt_last.val_point(Mc), 2)
+					+ pow(phi.val_point(Mc)-phi_last.val_point(Mc), 2) + pow(omega-omega_last, 2) ;
+				s_cur += sqrt(chord) ;
+			}
+		}
+		predictor.push (s_cur, {&nu, &incA, &incB, &incbt, &phi}, {omega}) ;
+		s_last = s_cur ;
+
+		nu_prev = nu_last ;
+		incA_prev = incA_last ;
+		incB_prev = incB_last ;
+		incbt_prev = incbt_last ;
+		phi_prev = phi_last ;
+		omega_prev = omega_last ;
+		nu_last = nu ;
+		incA_last = incA ;
+		incB_last = incB ;
+		incbt_last = incbt ;
+		phi_last = phi ;
+		omega_last = omega ;
+		lambda_last = lambda ;
+		kant++ ;
+	} ;
+
+	// bundle 模式：清单中的 path 为 "<bundle>#<id>"；只有 rank 0 追加，续扫时各 rank 只读打开
+	Bundle::Options bopts ;
+	bopts.trim_tol = store_tol ;
+	bopts.native = store_format==Io::Format::Native ;
+	std::unique_ptr<Bundle::Archive> bundle ;
+	std::unique_ptr<Bundle::Archive> bundle_in ;
+	// 已有 bundle 的网格须与当前配置一致（resol 或域边界改过时拒绝，否则追加的记录会与已有记录混在不同网格上）；
+	// 所有 rank 都打开，出错时一起退出
+	if (bundle_file[0]!='\0' && access (bundle_file, R_OK)==0) {
+		try {
+			bundle_in.reset (new Bundle::Archive(bundle_file, &space)) ;
+		}
+		catch (const std::exception& e) {
+			if (rank==0)
+				cerr << e.what() << endl ;
+			MPI_Finalize() ;
+			return 1 ;
+		}
+	}
+	MPI_Barrier (MPI_COMM_WORLD) ;	// 所有 rank 读完已有 bundle 后 rank 0 才可能新建
+	if (bundle_file[0]!='\0' && rank==0) {
+		if (access (bundle_file, F_OK)!=0)
+			Bundle::Archive::create (bundle_file, space, Io::SolutionKind::Axisymmetric) ;
+		bundle.reset (new Bundle::Archive(bundle_file, &space, true)) ;
+	}
+	auto available = [&] (const std::string& path) {
+		std::string file ;
+		int id ;
+		if (Bundle::split_ref (path, file, id))
+			return bundle_in && file==bundle_file && id<bundle_in->size() ;
+		return access (path.c_str(), R_OK)==0 ;
+	} ;
+
+	// 续扫：清单中本扫描（同一输入文件、扫描方向与 kk）已收敛且解仍在的点不再求解，
+	// 读回最近 max(pred_order+1, 2) 个点重建外推历史与割线，从最后一个收敛点继续
+	Manifest::Writer manifest (manifest_file, rank) ;
+	Observables::Table results (results_file, rank) ;
+	// 清单可能先于解文件落盘；续扫时 available() 检查文件，缺失的点会重算
+	std::unique_ptr<Async::Writer> writer ;
+	if (async_write && rank==0 && bundle_file[0]=='\0')
+		writer.reset (new Async::Writer) ;
+	// 扫描标识含定义扫描的参数（步长、模式、起点、外推阶数、弧长监测半径）：同一输入换了参数是另一条扫描，不续扫
+	char scan_params[200] ;
+	if (mode==1)
+		snprintf (scan_params, sizeof(scan_params), ":step=%.12g:mode=1:start=%.12g/%.12g:pred=%d:arc_r=%.12g", step, omega, lambda, pred_order, arc_r) ;
+	else
+		snprintf (scan_params, sizeof(scan_params), ":step=%.12g:mode=0:start=%.12g/%.12g:pred=%d", step, omega, lambda, pred_order) ;
+	std::string scan = std::string(input_file) + ((tar==0) ? ":omega" : ":lambda") + scan_params ;
+	std::vector<Manifest::Entry> done ;
+	for (const Manifest::Entry& e : Manifest::read (manifest_file))
+		if (e.scan==scan && e.kk==kk && e.status=="converged" && available (e.path))
+			done.push_back (e) ;
+	if (!done.empty()) {
+		size_t nkeep = std::max (pred_order+1, 2) ;
+		size_t first = (done.size()>nkeep) ? done.size()-nkeep : 0 ;
+		kant = int(first) ;
+		for (size_t i=first ; i<done.size() ; i++) {
+			std::string file ;
+			int id ;
+			if (Bundle::split_ref (done[i].path, file, id)) {
+				const Bundle::Archive::Fields& pt = bundle_in->load (id) ;
+				omega = bundle_in->entries()[id].omega ;
+				lambda = bundle_in->entries()[id].lambda ;
+				nu = *pt[0] ;
+				incA = *pt[1] ;
+				incB = *pt[2] ;
+				incbt = *pt[3] ;
+				phi = *pt[4] ;
+			}
+			else {
+				Io::Solution pt = Io::read_solution (done[i].path.c_str(), {}, &space) ;
+				omega = pt.omega ;
+				lambda = pt.lambda ;
+				nu = pt.field("nu") ;
+				incA = pt.field("incA") ;
+				incB = pt.field("incB") ;
+				incbt = pt.field("incbt") ;
+				phi = pt.field("phi") ;
+			}
+			phi.set_parameters() = parameters ;
+			remember () ;
+		}
+		// 固定步长模式沿用最后两点的间距；弧长步长置零，下一步由割线长度重新确定
+		size_t n = done.size() ;
+		if (n>=2) {
+			double last_step = (tar==0) ? done[n-2].omega-done[n-1].omega : done[n-2].lambda-done[n-1].lambda ;
+			if (last_step!=0 && fabs(last_step)<=4*fabs(step))
+				cur_step = last_step ;
+		}
+		if (rank==0)
+			cout << "Resuming scan from " << manifest_file << ": " << n << " points already converged, continuing from omega = "
+			     << omega_last << ", lambda = " << lambda_last << endl ;
+	}
+
+	while (kant<number) {
+		bool arclength = (mode==1) && (kant>=2) ;
 		if (kant !=0) {
-			if (tar==0) omega -= step;
-			else       lambda -= step;
+			nu = nu_last ;
+			incA = incA_last ;
+			incB = incB_last ;
+			incbt = incbt_last ;
+			phi = phi_last ;
+			omega = omega_last ;
+			lambda = lambda_last ;
+			if (arclength) {
+				xc[0] = nu_last.val_point(Mc) ;
+				xc[1] = incA_last.val_point(Mc) ;
+				xc[2] = incB_last.val_point(Mc) ;
+				xc[3] = incbt_last.val_point(Mc) ;
+				xc[4] = phi_last.val_point(Mc) ;
+				xc[5] = omega_last ;
+				tang[0] = xc[0] - nu_prev.val_point(Mc) ;
+				tang[1] = xc[1] - incA_prev.val_point(Mc) ;
+				tang[2] = xc[2] - incB_prev.val_point(Mc) ;
+				tang[3] = xc[3] - incbt_prev.val_point(Mc) ;
+				tang[4] = xc[4] - phi_prev.val_point(Mc) ;
+				tang[5] = xc[5] - omega_prev ;
+				double seclen = 0 ;
+				for (int i=0 ; i<6 ; i++)
+					seclen += tang[i]*tang[i] ;
+				seclen = sqrt(seclen) ;
+				for (int i=0 ; i<6 ; i++)
+					tang[i] /= seclen ;
+				if (arc_step==0)
+					arc_step = seclen ;
+				ds = arc_step ;
+			}
+			else {
+				if (tar==0) omega -= cur_step;
+				else       lambda -= cur_step;
+			}
+
+			// 由最近 pred_order+1 个收敛解外推初值；弧长模式以累计弦长为参数并同时外推 ome
+			if (mode==1)
+				predictor.predict (s_last + ds, {&nu, &incA, &incB, &incbt, &phi}, arclength ? std::vector<double*>{&omega} : std::vector<double*>{}) ;
+			else
+				predictor.predict ((tar==0) ? omega : lambda, {&nu, &incA, &incB, &incbt, &phi}) ;
+			phi.set_parameters() = parameters ;
 		}
 
 	if (rank==0) {
-	  if (tar==0)
+	  if (arclength)
+	    cout << "Arclength step ds = " << ds << " (predicted omega " << omega << ")" << endl;
+	  else if (tar==0)
 	    cout << "Computation with omega = " << omega << endl;
 	  else
 	    cout << "Computation with lambda = " << lambda << " (omega fixed " << omega << ")" << endl;
 	}
 
-      Scalar one (space) ;
-      one = 1 ;
-      one.std_base() ;
-      Scalar rsint (space) ;
-    for (int d=0 ; d<ndom-1 ; d++)
-		rsint.set_domain(d) = space.get_domain(d)->mult_r(space.get_domain(d)->mult_sin_theta(one(d))) ;
-    rsint.set_domain(ndom-1) = space.get_domain(ndom-1)->mult_sin_theta(one(ndom-1)) ;
-  
-
-      System_of_eqs syst (space, 0, ndom-1) ;
-  
-      syst.add_var ("incB", incB) ;
-      syst.add_var ("nu", nu) ;
-      syst.add_var ("incA", incA) ;
-      syst.add_var ("phi", phi) ;
-      syst.add_var ("incbt",incbt) ;
-      syst.add_cst ("ome", omega) ;
-
-      syst.add_cst ("rsint", rsint) ;
-      syst.add_cst ("k", kk) ;
-	syst.add_cst ("qpi", qpi) ;
-	syst.add_cst ("lambda", lambda) ;
-
-      syst.add_def ("phisurrsint = divrsint(phi)") ;
-      syst.add_def ("ap = exp(nu)") ;
-      syst.add_def ("bt = divrsint(incbt)") ;
-      syst.add_def ("B = (divrsint(incB) + 1)/ap") ;
-      syst.add_def ("A = exp(incA - nu)") ;
-      
-	syst.add_def ("E = 0.5*(ome-bt*k)^2/ap^2*phi^2 + 0.5*scal(grad(phi),grad(phi))/A^2 + 0.5*phi^2 + 0.25*lambda*phi^4 + 0.5*k*k*phisurrsint*phisurrsint/B^2") ;
-      syst.add_def ("Pp = k/ap* (ome-bt*k)*phi^2") ;
-	syst.add_def ("S = -0.5*scal(grad(phi), grad(phi))/A^2 - 0.5*k*k*phisurrsint*phisurrsint/B^2 + 1.5*(ome-bt*k)^2/ap^2 * phi^2- 1.5*phi^2 -0.75*lambda*phi^4") ;
-	syst.add_def ("Spp = 0.5*(ome-bt*k)^2/ap^2*phi^2 -0.5* scal(grad(phi),grad(phi))/A^2 -0.5* phi^2 -0.25*lambda*phi^4 +0.5* k*k*phisurrsint*phisurrsint/B^2") ;
-       
-	  for (int d=0 ; d<ndom-1 ; d++)
-	  syst.add_def (d, "eqB = lap2(incB) -2*qpi*ap*A^2*B*rsint*(S-Spp)") ;
-      syst.add_def (ndom-1, "eqB = lap2(incB) -2*qpi*ap*A^2*B*rsint*multr(S-Spp)") ;
-
-
-
-	for (int d=0 ; d<ndom-1 ; d++)
-	syst.add_def (d, "eqshift = lap(incbt) - divrsint(bt) - rsint*scal(grad(bt),grad(nu-3*log(B)))+4*qpi*ap*A^2/B^2*divrsint(Pp)") ;
-      syst.add_def (ndom-1, "eqshift = lap(incbt) - divrsint(bt) - rsint*scal(multr(grad(bt)),grad(nu-3*log(B)))+4*qpi*ap*A^2/B^2*divrsint(Pp)") ;
-     
- 
-      for (int d=0 ; d<ndom-1 ; d++)
-	syst.add_def (d, "eqnu = lap(nu) - B^2*rsint^2/2/ap^2 * scal(grad(bt) , grad(bt)) + scal(grad(nu), grad(nu+log(B))) - qpi*A^2*(E+S)") ;
-      syst.add_def (ndom-1, "eqnu = lap(nu) - B^2*rsint^2/2/ap^2 * scal(multr(grad(bt)) , multr(grad(bt))) + scal(grad(nu), grad(nu+log(B))) - qpi*A^2*(E+S)") ;
-	
-    
-     for (int d=0 ; d<ndom-1 ; d++) 
-	syst.add_def (d, "eqA = lap2(incA) - 2*qpi*A^2*Spp- 3 * B^2 * rsint^2 /4 / ap^2 * scal(grad(bt) , grad(bt)) + scal(grad(nu),grad(nu))") ;
-       syst.add_def (ndom-1, "eqA =lap2(incA) - 2*qpi*A^2*Spp- 3 * B^2 * rsint^2 /4 / ap^2 * scal(multr(grad(bt)) , multr(grad(bt))) + scal(grad(nu),grad(nu)) ") ;
-    
- 
-	syst.add_def ("print = lap2(incA)") ;
-
-		    for (int d=0 ; d<ndom-1 ; d++)
-		syst.add_def (d, "eqphi = lap(phi) - A^2*(1 + lambda*phi^2 -ome*ome/ap^2+2*bt/ap^2*ome*k-bt^2/ap^2*k*k)*phi + scal(grad(phi),grad(nu+log(B))) - divrsint(A^2/B^2 -1)*divrsint(phi)*k*k") ;
-		syst.add_def (ndom-1, "eqphi = lap(phi) - A^2*(1 + lambda*phi^2 -ome*ome/ap^2+2*bt/ap^2*ome*k-bt^2/ap^2*k*k)*phi + scal(grad(phi),grad(nu+log(B))) - k*k*divrsint(A^2/B^2-1)*divrsint(phi)") ;
-  
-      
-      space.add_eq (syst, "eqB=0", "incB", "dn(incB)") ; 
-      space.add_eq (syst, "eqA=0", "incA", "dn(incA)") ; 
-      space.add_eq (syst, "eqphi=0", "phi", "dn(phi)") ; 
-      space.add_eq (syst, "eqnu=0", "nu", "dn(nu)") ; 
-      space.add_eq (syst, "eqshift=0", "incbt", "dn(incbt)") ; 
-       
-    
-      syst.add_eq_bc (ndom-1, OUTER_BC, "nu=0") ;
-      syst.add_eq_bc (ndom-1, OUTER_BC, "incA=0") ;
-      syst.add_eq_bc (ndom-1, OUTER_BC, "incB=0") ;
-      syst.add_eq_bc (ndom-1, OUTER_BC, "incbt=0") ;
-      syst.add_eq_bc (ndom-1, OUTER_BC, "phi=0") ;
-
-      double conv ;
-      bool endloop = false ;
-      int ite = 1 ;
-      while (!endloop) {
-	endloop = syst.do_newton(1e-8, conv) ;
+      Axi::Session& session = arclength ? arc : fixed ;
+      session.begin_solve() ;
+      double t_start = MPI_Wtime() ;
+
+      // Newton 迭代：超过 max_ite、停滞或残差发散视为失败（判据见 utils/newton_driver.hpp）
+      Newton::Report rep = session.solve (nopts, [&] (int ite, double conv, bool ls) {
 	if(rank==0)
-	        cout << "Newton iteration " << ite << " " << conv  << endl ;
-	ite++ ;
-	 }
+	        cout << "Newton iteration " << ite << " " << conv  << " " << omega << (ls ? " (line search)" : "") << endl ;
+      }) ;
+      int ite = rep.ite ;
+      double rate = rep.rate ;
+
+      Manifest::Entry entry ;
+      entry.scan = scan ;
+      entry.kk = kk ;
+      entry.omega = omega ;
+      entry.lambda = lambda ;
+      entry.status = Newton::status_name (rep.status) ;
+      entry.ite = ite ;
+      entry.wall = MPI_Wtime() - t_start ;
+
+	if (!rep.converged()) {
+		on_rank0 (rank, "manifest", [&] { manifest.append (entry) ; }) ;
+		session.invalidate_jacobian() ;
+		retry++ ;
+		if (rank==0)
+			cout << "Newton failed: status = " << Newton::status_name(rep.status)
+			     << ", iterations = " << rep.ite << ", residual = " << rep.conv << endl ;
+		if (kant==0 || retry>max_retry) {
+			if (rank==0)
+				cout << "Newton failed after " << retry << " retries, stopping the scan" << endl ;
+			break ;
+		}
+		if (arclength)
+			arc_step *= 0.5 ;
+		else
+			cur_step *= 0.5 ;
+		if (rank==0)
+			cout << "Newton failed, retrying from the last converged point with a halved step" << endl ;
+		continue ;
+	}
+
+	// 按迭代次数与收敛速率调整下一步步长
+	if (kant!=0) {
+		double fac = 1 ;
+		if (ite<=fast_ite || rate<1e-2)
+			fac = step_grow ;
+		else if (ite>=slow_ite)
+			fac = 0.7 ;
+		if (arclength)
+			arc_step *= fac ;
+		else {
+			cur_step *= fac ;
+			if (fabs(cur_step)>4*fabs(step))
+				cur_step = 4*step ;
+		}
+	}
+	retry = 0 ;
+	if (rank==0 && solver==1)
+		cout << "Jacobian factorizations so far: " << fixed.nbr_factorizations() + arc.nbr_factorizations() << endl ;
+	if (rank==0 && solver==2)
+		cout << "GMRES iterations so far: " << jfnk_fixed->nbr_krylov() + (jfnk_arc ? jfnk_arc->nbr_krylov() : 0)
+		     << ", coarse factorizations: " << jfnk_fixed->nbr_factorizations() + (jfnk_arc ? jfnk_arc->nbr_factorizations() : 0) << endl ;
 
 
 	
-	if (rank==0) {
-	
-		char name[100] ;
-		sprintf (name, "bos_%d_%f_%f.dat", kk, omega, lambda) ;
-		FILE* fiche = fopen (name, "w") ;
-		space.save(fiche) ;
-		fwrite_be (&kk, sizeof(int), 1, fiche) ;
-		fwrite_be (&omega, sizeof(double), 1, fiche) ;
-		fwrite_be (&lambda, sizeof(double), 1, fiche ) ;
-		nu.save(fiche) ;
-		incA.save(fiche) ;
-		incB.save(fiche) ;
-		incbt.save(fiche) ;
-		phi.save(fiche) ;
-		fclose(fiche) ;
+	// 写失败时该点记为 write_failed（续扫时会重算），解仍在内存中，扫描照常继续
+	bool stored = on_rank0 (rank, "store", [&] {
+		if (bundle) {
+			int id = bundle->append (kk, omega, lambda, {&nu, &incA, &incB, &incbt, &phi}, bopts) ;
+			entry.path = Bundle::make_ref (bundle_file, id) ;
+		}
+		else {
+			char name[100] ;
+			sprintf (name, "bos_%d_%f_%f.dat", kk, omega, lambda) ;
+			if (writer)
+				writer->submit (name, Io::encode_axisymmetric (space, kk, omega, lambda, nu, incA, incB, incbt, phi, store_format, store_tol)) ;
+			else
+				Io::save_axisymmetric (name, space, kk, omega, lambda, nu, incA, incB, incbt, phi, store_format, store_tol) ;
+			entry.path = name ;
 		}
+	}) ;
+	if (!stored) {
+		entry.status = "write_failed" ;
+		entry.path.clear() ;
+	}
+	on_rank0 (rank, "manifest", [&] { manifest.append (entry) ; }) ;
+	if (stored)
+		on_rank0 (rank, "results", [&] {
+			if (results.enabled()) {
+				Observables::Values obs = Observables::axisymmetric (space, kk, omega, lambda, nu, incA, incB, incbt, phi) ;
+				results.append (scan, obs, ite, entry.wall, entry.path) ;
+				cout << "Madm = " << obs.Madm << ", Mkomar = " << obs.Mkomar << ", Js = " << obs.Js << ", Jv = " << obs.Jv << endl ;
+			}
+		}) ;
+
+	remember () ;
+	}
+
+	if (writer) {
+		writer->drain () ;
+		if (writer->failures()>0)
+			cerr << writer->failures() << " solution files could not be written" << endl ;
 	}
 
 #ifdef ENABLE_GPU_USE
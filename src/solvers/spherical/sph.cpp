@@ -1,5 +1,10 @@
 #include "kadath_polar.hpp"
 #include "mpi.h"
+#include "utils/chord_newton.hpp"
+#include "utils/newton_driver.hpp"
+#include "utils/checkpoint.hpp"
+#include "utils/io_commons.hpp"
+#include "utils/regrid.hpp"
 #include <cmath>
 #include <iostream>
 #include <sstream>
@@ -45,6 +50,9 @@ int main(int argc, char** argv)
     double omega  = 0.98;  
     double lambda = 0.0; 
     double phi_c  = 0.005; 
+    int solver = 0;        // 0: 完整 Newton；1: 弦方法（复用分解的 Jacobian，Broyden 修正）
+    const char* checkpoint_file = "sph.ckpt";  // 每次迭代后写出的检查点（空串关闭）；续算：sph --resume sph.ckpt
+    Io::Format store_format = Io::Format::Legacy;  // 解文件格式：Legacy 顺序格式、Indexed 带索引、Native 带索引且按本机字节序存系数
 
     double pi = M_PI;
 
@@ -77,6 +85,40 @@ int main(int argc, char** argv)
     phi.set_domain(ndom-1) = 0;
     phi.std_base();
 
+    // 续算：检查点的网格与上面配置的空间不同（resol 或域边界改过）时把场谱插值到当前空间
+    Checkpoint::Progress progress;
+    std::string resume = Checkpoint::resume_path(argc, argv);
+    if (!resume.empty()) {
+        bool ok = Checkpoint::read(resume, progress, [&](FILE* f) {
+            Space_polar saved(f);
+            if (fread_be(&omega, sizeof(double), 1, f) != 1 || fread_be(&lambda, sizeof(double), 1, f) != 1)
+                throw std::runtime_error("truncated parameters");
+            if (Regrid::grid_key(saved) == Regrid::grid_key(space)) {
+                psi = Scalar(space, f);
+                nu = Scalar(space, f);
+                phi = Scalar(space, f);
+            } else {
+                if (rank == 0)
+                    cout << "Checkpoint grid " << Regrid::grid_key(saved) << " differs from the configured grid "
+                         << Regrid::grid_key(space) << ", interpolating" << endl;
+                Scalar psi_saved(saved, f);
+                Scalar nu_saved(saved, f);
+                Scalar phi_saved(saved, f);
+                psi = Regrid::transfer(psi_saved, psi);
+                nu = Regrid::transfer(nu_saved, nu);
+                phi = Regrid::transfer(phi_saved, phi);
+            }
+        });
+        if (!ok) {
+            if (rank == 0)
+                cerr << "Cannot read checkpoint " << resume << endl;
+            MPI_Finalize();
+            return 1;
+        }
+        if (rank == 0)
+            cout << "Resuming after " << progress.history.size() << " Newton iterations" << endl;
+    }
+
     System_of_eqs syst(space, 0, ndom-1);
 
     syst.add_cst("pi", pi);
@@ -157,18 +199,61 @@ int main(int argc, char** argv)
     // 9. Newton 求解
     // =================================================
 
-    bool end = false;
-    double conv = 1.0;
-    int it = 0;
-
-    while (!end) {
-        end = syst.do_newton(1e-9, conv);
+    Newton::Options opts;   // 迭代上限、停滞 / 发散判据与线搜索回退，见 utils/newton_driver.hpp
+    opts.prec = 1e-9;
+    opts.max_ite = 30;
+    opts.resume_history = progress.history;
+    opts.resume_linesearch_from = progress.linesearch_from;
+
+    Checkpoint::install_sigterm_handler();
+    Checkpoint::Writer writer(checkpoint_file, rank);
+    if (checkpoint_file[0])
+        opts.stop = Checkpoint::stop_requested;
+
+    Chord::Engine chord(syst);
+    Newton::Snapshot snap({&psi, &nu, &phi}, {&omega});
+    Newton::Report rep = Newton::run(opts,
+        [&](double prec, double& conv) {
+            return (solver == 1) ? chord.step(prec, conv) : syst.do_newton(prec, conv);
+        },
+        [&](double prec, double& conv, int ntry, double stepmax) {
+            return syst.do_newton_with_linesearch(prec, conv, ntry, stepmax);
+        },
+        &snap,
+        [&](int it, double conv, bool ls) {
+            if (rank == 0)
+                cout << "Iter " << it
+                     << "   conv=" << conv
+                     << "   omega=" << omega << (ls ? "   (line search)" : "") << endl;
+            if (checkpoint_file[0]) {
+                if (ls && progress.linesearch_from < 0)
+                    progress.linesearch_from = int(progress.history.size());
+                progress.history.push_back(conv);
+                writer.write(progress, [&](FILE* f) {
+                    space.save(f);
+                    fwrite_be(&omega, sizeof(double), 1, f);
+                    fwrite_be(&lambda, sizeof(double), 1, f);
+                    psi.save(f);
+                    nu.save(f);
+                    phi.save(f);
+                });
+            }
+        });
+
+    if (rep.status == Newton::Status::Interrupted) {
         if (rank == 0)
-            cout << "Iter " << it
-                 << "   conv=" << conv
-                 << "   omega=" << omega << endl;
-        it++;
-        if (it > 30) break;
+            cerr << "Interrupted, continue with --resume " << checkpoint_file << endl;
+        MPI_Finalize();
+        return 1;
+    }
+    if (!rep.converged()) {
+        if (rank == 0)
+            cerr << "Newton failed: status=" << Newton::status_name(rep.status)
+                 << " first_pass=" << Newton::status_name(rep.first_status)
+                 << " iterations=" << rep.ite
+                 << " residual=" << rep.conv << ", no solution written" << endl;
+        MPI_Finalize();
+        return 1;
     }
 
     // =================================================
@@ -183,15 +268,7 @@ int main(int argc, char** argv)
           << "_om"  << std::fixed << std::setprecision(5) << omega
           << ".dat";
 
-    FILE* f = fopen(fname.str().c_str(), "w");
-
-    space.save(f);
-    fwrite_be(&omega,  sizeof(double), 1, f);
-    fwrite_be(&lambda, sizeof(double), 1, f);
-    psi.save(f);
-    nu.save(f);
-    phi.save(f);
-    fclose(f);
+    Io::save_spherical(fname.str().c_str(), space, omega, lambda, psi, nu, phi, store_format);
 
     std::cerr << "Saved solution to " << fname.str() << std::endl;
     }
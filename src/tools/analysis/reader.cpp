@@ -1,4 +1,7 @@
+#include "utils/batch_files.hpp"
 #include "utils/io_commons.hpp"
+#include "utils/observables.hpp"
+#include "utils/resample.hpp"
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -6,7 +9,16 @@
 #include <iomanip>
 #include <cmath>
 #include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <sys/stat.h>
 
 using namespace Kadath;
 using Io::SolutionKind;
@@ -15,7 +27,18 @@ static void usage(const char* prog) {
 	std::cerr << "Usage: " << prog << " <solution.dat> <tar> [output.txt]\n";
 	std::cerr << "  tar=0  compute mode (auto-detect spherical/axisymmetric)\n";
 	std::cerr << "  tar=1  export mode (auto-detect spherical/axisymmetric)\n";
-	std::cerr << "  output.txt defaults to <solution>.txt when tar=1\n";
+	std::cerr << "  tar=2  binary export: one .npy per domain and field plus meta.json\n";
+	std::cerr << "         options: [output_dir] [--f32] [--coef]\n";
+	std::cerr << "  tar=3  resample onto a uniform grid: one .npy of shape (n1, n2) per field plus meta.json\n";
+	std::cerr << "         grid:    polar n_r r0 r1 n_theta theta0 theta1 | cart n_x x0 x1 n_z z0 z1\n";
+	std::cerr << "         options: [output_dir] [--f32] [--threads N] [--fields name,name,...]\n";
+	std::cerr << "  tar=4  batch compute: <solution.dat> is a directory, a quoted glob or @list.txt;\n";
+	std::cerr << "         one CSV row per file. options: [output.csv] [--jobs N]\n";
+	std::cerr << "  tar=5  field coding benchmark: Scalar::save (big-endian) vs native coefficient block,\n";
+	std::cerr << "         written to and read back from memory. options: [repeat]\n";
+	std::cerr << "  tar=0 and tar=4 cache results by file content: [--cache dir] [--no-cache]\n";
+	std::cerr << "  output.txt defaults to <solution>.txt when tar=1, output_dir to <solution>_npy when tar=2\n";
+	std::cerr << "  and to <solution>_grid when tar=3, output.csv to observables.csv when tar=4\n";
 }
 
 static std::string default_output_path(const std::string& input) {
@@ -24,6 +47,190 @@ static std::string default_output_path(const std::string& input) {
 	return input + ".txt";
 }
 
+static std::string default_npy_dir(const std::string& input, const std::string& suffix = "_npy") {
+	if (input.size() >= 4 && input.substr(input.size() - 4) == ".dat")
+		return input.substr(0, input.size() - 4) + suffix;
+	return input + suffix;
+}
+
+struct Npy_options {
+	bool f32 = false;    // float32 代替 float64
+	bool coef = false;   // 写谱系数而非配置点上的值（此时不写坐标）
+	int threads = 0;     // tar=3 的求和线程数，0 为硬件线程数
+	std::vector<std::string> only;   // tar=3 只导出这些场，空为全部
+};
+
+// NumPy .npy 1.0：头部按 64 字节对齐，数据为本机字节序的 C 序数组
+// n1 < 0 时写一维数组
+static void write_npy(const std::string& path, const std::vector<double>& data, int n0, int n1, bool f32) {
+	FILE* f = fopen(path.c_str(), "wb");
+	if (!f)
+		throw std::runtime_error("Cannot open output file: " + path);
+	std::string descr = std::string(Io::detail::host_little_endian() ? "<" : ">") + (f32 ? "f4" : "f8");
+	std::string shape = n1 < 0 ? std::to_string(n0) + "," : std::to_string(n0) + ", " + std::to_string(n1);
+	std::string header = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': (" + shape + "), }";
+	size_t total = 10 + header.size() + 1;
+	header.append((64 - total % 64) % 64, ' ');
+	header += '\n';
+	std::uint16_t hlen = std::uint16_t(header.size());
+	const unsigned char preamble[8] = {0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0};
+	unsigned char len_le[2] = {(unsigned char)(hlen & 0xff), (unsigned char)(hlen >> 8)};
+	fwrite(preamble, 1, 8, f);
+	fwrite(len_le, 1, 2, f);
+	fwrite(header.data(), 1, header.size(), f);
+	if (f32) {
+		std::vector<float> buf(data.begin(), data.end());
+		fwrite(buf.data(), sizeof(float), buf.size(), f);
+	} else {
+		fwrite(data.data(), sizeof(double), data.size(), f);
+	}
+	fclose(f);
+}
+
+// 每个域每个场一个 d<k>_<name>.npy，形状 (n_theta, n_r)（r 方向连续），配置空间另写 d<k>_r / d<k>_theta；
+// 元数据写在 meta.json
+static void write_npy_dir(const std::string& dir,
+						  const Space_polar& space,
+						  int kk,
+						  double omega,
+						  double lambda,
+						  const std::vector<std::string>& names,
+						  const std::vector<const Scalar*>& fields,
+						  const Npy_options& opt) {
+	if (names.size() != fields.size())
+		throw std::runtime_error("column names and fields size mismatch");
+	if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+		throw std::runtime_error("Cannot create output directory: " + dir);
+
+	std::ofstream meta(dir + "/meta.json");
+	if (!meta)
+		throw std::runtime_error("Cannot open output file: " + dir + "/meta.json");
+	meta << std::setprecision(17);
+	meta << "{\n  \"omega\": " << omega << ",\n  \"lambda\": " << lambda << ",\n";
+	if (kk >= 0)
+		meta << "  \"kk\": " << kk << ",\n";
+	meta << "  \"dtype\": \"" << (opt.f32 ? "float32" : "float64") << "\",\n";
+	meta << "  \"space\": \"" << (opt.coef ? "coef" : "conf") << "\",\n";
+	meta << "  \"layout\": \"C order, shape (n_theta, n_r)\",\n";
+	meta << "  \"fields\": [";
+	for (size_t i = 0; i < names.size(); ++i)
+		meta << (i ? ", " : "") << "\"" << names[i] << "\"";
+	meta << "],\n  \"domains\": [\n";
+
+	int ndom = space.get_nbr_domains();
+	std::vector<double> buf;
+	for (int d = 0; d < ndom; ++d) {
+		const Domain* dom = space.get_domain(d);
+		Dim_array dims = opt.coef ? dom->get_nbr_coefs() : dom->get_nbr_points();
+		int nr = dims(0);
+		int nt = dims(1);
+		std::string prefix = dir + "/d" + std::to_string(d) + "_";
+
+		for (size_t i = 0; i < fields.size(); ++i) {
+			const Val_domain& v = (*fields[i])(d);
+			buf.assign(size_t(nr) * nt, 0.0);
+			if (!v.check_if_zero()) {
+				if (opt.coef)
+					v.coef();
+				else
+					v.coef_i();
+				Index idx(dims);
+				size_t n = 0;
+				do {
+					buf[n++] = opt.coef ? v.get_coef()(idx) : v(idx);
+				} while (idx.inc());
+			}
+			write_npy(prefix + names[i] + ".npy", buf, nt, nr, opt.f32);
+		}
+
+		if (!opt.coef) {
+			// theta 取同一射线上 0 < r < inf 的点的方向：核与壳取外边界（核的内边界是原点），紧致域取内边界
+			const Val_domain& rr = dom->get_radius();
+			const Val_domain& xx = dom->get_cart(1);
+			const Val_domain& zz = dom->get_cart(2);
+			std::vector<double> th(size_t(nr) * nt);
+			buf.resize(size_t(nr) * nt);
+			Index idx(dims);
+			size_t n = 0;
+			do {
+				Index edge(idx);
+				edge.set(0) = nr - 1;
+				if (!std::isfinite(rr(edge)))
+					edge.set(0) = 0;
+				buf[n] = rr(idx);
+				th[n] = atan2(xx(edge), zz(edge));
+				n++;
+			} while (idx.inc());
+			write_npy(prefix + "r.npy", buf, nt, nr, opt.f32);
+			write_npy(prefix + "theta.npy", th, nt, nr, opt.f32);
+		}
+		meta << "    {\"index\": " << d << ", \"shape\": [" << nt << ", " << nr << "]}" << (d + 1 < ndom ? "," : "") << "\n";
+	}
+	meta << "  ]\n}\n";
+}
+
+// 均匀网格上的重采样：每个场一个 <name>.npy，形状 (n1, n2)（第二维连续），两个坐标轴另写一维数组；
+// 求和见 Resample::run
+static void write_grid_dir(const std::string& dir,
+						   const Space_polar& space,
+						   const Resample::Grid& grid,
+						   int kk,
+						   double omega,
+						   double lambda,
+						   const std::vector<std::string>& names,
+						   const std::vector<const Scalar*>& fields,
+						   const Npy_options& opt) {
+	if (names.size() != fields.size())
+		throw std::runtime_error("column names and fields size mismatch");
+	std::vector<std::string> out_names;
+	std::vector<const Scalar*> out_fields;
+	for (size_t i = 0; i < names.size(); ++i) {
+		bool wanted = opt.only.empty();
+		for (const std::string& n : opt.only)
+			wanted = wanted || n == names[i];
+		if (wanted) {
+			out_names.push_back(names[i]);
+			out_fields.push_back(fields[i]);
+		}
+	}
+	if (out_fields.empty())
+		throw std::runtime_error("no field selected by --fields");
+	if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+		throw std::runtime_error("Cannot create output directory: " + dir);
+
+	std::vector<std::vector<double>> values = Resample::run(space, out_fields, grid, opt.threads);
+	for (size_t i = 0; i < out_fields.size(); ++i)
+		write_npy(dir + "/" + out_names[i] + ".npy", values[i], grid.n1, grid.n2, opt.f32);
+
+	const char* axis1 = grid.cartesian ? "x" : "r";
+	const char* axis2 = grid.cartesian ? "z" : "theta";
+	std::vector<double> axis(grid.n1);
+	for (int i = 0; i < grid.n1; ++i)
+		axis[i] = grid.u(i);
+	write_npy(dir + "/" + axis1 + ".npy", axis, grid.n1, -1, opt.f32);
+	axis.resize(grid.n2);
+	for (int j = 0; j < grid.n2; ++j)
+		axis[j] = grid.v(j);
+	write_npy(dir + "/" + axis2 + ".npy", axis, grid.n2, -1, opt.f32);
+
+	std::ofstream meta(dir + "/meta.json");
+	if (!meta)
+		throw std::runtime_error("Cannot open output file: " + dir + "/meta.json");
+	meta << std::setprecision(17);
+	meta << "{\n  \"omega\": " << omega << ",\n  \"lambda\": " << lambda << ",\n";
+	if (kk >= 0)
+		meta << "  \"kk\": " << kk << ",\n";
+	meta << "  \"dtype\": \"" << (opt.f32 ? "float32" : "float64") << "\",\n";
+	meta << "  \"grid\": \"" << (grid.cartesian ? "cart" : "polar") << "\",\n";
+	meta << "  \"layout\": \"C order, shape (n_" << axis1 << ", n_" << axis2 << ")\",\n";
+	meta << "  \"" << axis1 << "\": [" << grid.a0 << ", " << grid.a1 << ", " << grid.n1 << "],\n";
+	meta << "  \"" << axis2 << "\": [" << grid.b0 << ", " << grid.b1 << ", " << grid.n2 << "],\n";
+	meta << "  \"fields\": [";
+	for (size_t i = 0; i < out_names.size(); ++i)
+		meta << (i ? ", " : "") << "\"" << out_names[i] << "\"";
+	meta << "]\n}\n";
+}
+
 static void write_txt(const std::string& path,
 					  const Space_polar& space,
 					  double omega,
@@ -68,6 +275,165 @@ static void write_txt(const std::string& path,
 	}
 }
 
+static void print_values(const Observables::Values& v) {
+	if (v.kind == SolutionKind::Axisymmetric) {
+		std::cout << "Axisymmetric boson star\n";
+		std::cout << "k        = " << v.kk << "\n";
+		std::cout << "omega    = " << v.omega << "\n";
+		std::cout << "lambda   = " << v.lambda << "\n";
+		std::cout << "Madm     = " << v.Madm << "\n";
+		std::cout << "Mkomar   = " << v.Mkomar << "\n";
+		std::cout << "Js       = " << v.Js << "\n";
+		std::cout << "Jv       = " << v.Jv << "\n";
+		std::cout << "diff Komar ADM = " << v.diff_mass() << "\n";
+		std::cout << "diff Js and Jv = " << v.diff_j() << "\n";
+	} else {
+		std::cout << "Spherical solution\n";
+		std::cout << "omega    = " << v.omega << "\n";
+		std::cout << "lambda   = " << v.lambda << (v.has_lambda ? " (file)" : " (assumed)") << "\n";
+		std::cout << "Madm     = " << v.Madm << "\n";
+		std::cout << "Mkomar   = " << v.Mkomar << "\n";
+		std::cout << "diff Komar ADM = " << v.diff_mass() << "\n";
+	}
+}
+
+static const char* CSV_HEADER = "file,kind,kk,omega,lambda,Madm,Mkomar,Js,Jv,diff_mass,diff_j,status";
+
+static std::string csv_row(const std::string& file, const Observables::Values& v) {
+	char buf[512];
+	snprintf(buf, sizeof(buf), ",%s,%d,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,ok",
+			 v.kind == SolutionKind::Axisymmetric ? "axisymmetric" : "spherical", v.kk, v.omega, v.lambda,
+			 v.Madm, v.Mkomar, v.Js, v.Jv, v.diff_mass(), v.kind == SolutionKind::Axisymmetric ? v.diff_j() : NAN);
+	return file + buf;
+}
+
+// Kadath 不是线程安全的，文件分给 fork 出的工作进程（见 Batch_files::run），结果按输入顺序合并；
+// 每个进程内同一网格的 Space_polar 只构造一次，cache 非空时先按文件内容查缓存，命中的文件不解析
+static int run_batch(const std::string& spec, const std::string& output, int jobs, const Observables::Cache* cache) {
+	std::vector<std::string> files = Batch_files::expand(spec);
+	if (files.empty())
+		throw std::runtime_error("no solution files match " + spec);
+	if (jobs <= 0)
+		jobs = Batch_files::default_jobs();
+
+	Io::Space_cache spaces;
+	std::vector<std::string> rows = Batch_files::run(files.size(), jobs, output, [&](size_t i) {
+		try {
+			Observables::Values v;
+			std::string key = cache ? Observables::Cache::key(files[i].c_str()) : std::string();
+			if (!cache || !cache->load(key, v)) {
+				Io::Solution sol = Io::read_solution(files[i].c_str(), {}, spaces.get(files[i].c_str()));
+				v = Observables::compute(sol);
+				if (cache)
+					cache->store(key, v);
+			}
+			return csv_row(files[i], v);
+		} catch (const std::exception& e) {
+			std::cerr << files[i] << ": " << e.what() << "\n";
+			return files[i] + ",,,,,,,,,,,error";
+		}
+	});
+
+	std::ofstream out(output);
+	if (!out)
+		throw std::runtime_error("Cannot open output file: " + output);
+	out << CSV_HEADER << "\n";
+	int nfail = 0;
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (rows[i].empty())
+			rows[i] = files[i] + ",,,,,,,,,,,error";
+		if (rows[i].compare(rows[i].size() - 5, 5, "error") == 0)
+			nfail++;
+		out << rows[i] << "\n";
+	}
+	std::cout << "batch: " << files.size() << " files, " << nfail << " failed, "
+			  << std::min<size_t>(size_t(jobs), files.size()) << " workers -> " << output << "\n";
+	return nfail == 0 ? 0 : 1;
+}
+
+// 内存中的 FILE*：写完后取出字节，避免磁盘缓存干扰计时
+static std::string to_memory(const std::function<void(FILE*)>& write) {
+	char* buf = nullptr;
+	size_t size = 0;
+	FILE* m = open_memstream(&buf, &size);
+	if (!m)
+		throw std::runtime_error("open_memstream failed");
+	write(m);
+	fclose(m);
+	std::string out(buf, size);
+	free(buf);
+	return out;
+}
+
+template <typename Fn>
+static double time_ms(int repeat, Fn&& fn) {
+	auto t0 = std::chrono::steady_clock::now();
+	for (int r = 0; r < repeat; ++r)
+		fn();
+	auto t1 = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(t1 - t0).count() / repeat;
+}
+
+// 场编码对比：ENC_RAW（Scalar::save，逐个大端）与 ENC_COEF_*（系数块整块拷贝），读写都在内存中进行，
+// 并核对读回的系数与原场一致
+static int run_bench(const char* input, int repeat) {
+	Io::Solution sol = Io::read_solution(input);
+	const Space_polar& space = *sol.space;
+	bool little = Io::detail::host_little_endian();
+	std::cout << "mode      = bench (" << repeat << " repeats, times in ms per field)\n";
+	std::cout << std::left << std::setw(8) << "field" << std::right
+			  << std::setw(12) << "raw_bytes" << std::setw(12) << "raw_write" << std::setw(12) << "raw_read"
+			  << std::setw(12) << "coef_bytes" << std::setw(12) << "coef_write" << std::setw(12) << "coef_read" << "\n";
+	double tot[4] = {0, 0, 0, 0};
+	for (size_t i = 0; i < sol.fields.size(); ++i) {
+		const Scalar& s = *sol.fields[i];
+		// 先各写一次：谱系数在此算好，计时中两种编码都不含 coef() 的变换
+		std::string coef = to_memory([&](FILE* m) { Io::detail::write_coefs(s, m); });
+		std::string raw = to_memory([&](FILE* m) { s.save(m); });
+
+		double w_raw = time_ms(repeat, [&] { to_memory([&](FILE* m) { s.save(m); }); });
+		double w_coef = time_ms(repeat, [&] { to_memory([&](FILE* m) { Io::detail::write_coefs(s, m); }); });
+		std::unique_ptr<Scalar> back;
+		double r_raw = time_ms(repeat, [&] {
+			FILE* m = fmemopen(&raw[0], raw.size(), "r");
+			back.reset(new Scalar(space, m));
+			fclose(m);
+		});
+		double r_coef = time_ms(repeat, [&] {
+			FILE* m = fmemopen(&coef[0], coef.size(), "r");
+			try {
+				back.reset(Io::detail::read_coefs(space, m, input, little));
+			} catch (...) {
+				fclose(m);
+				throw;
+			}
+			fclose(m);
+		});
+		bool same = true;
+		for (int d = 0; d < space.get_nbr_domains() && same; ++d) {
+			if (s(d).check_if_zero())
+				continue;
+			const double* a = s(d).get_coef().get_data();
+			const double* b = (*back)(d).get_coef().get_data();
+			same = std::equal(a, a + Io::detail::nbr_coefs(space, d), b);
+		}
+		if (!same)
+			throw std::runtime_error("field " + sol.names[i] + " does not round-trip through the coefficient block");
+
+		std::cout << std::left << std::setw(8) << sol.names[i] << std::right << std::fixed << std::setprecision(3)
+				  << std::setw(12) << raw.size() << std::setw(12) << w_raw << std::setw(12) << r_raw
+				  << std::setw(12) << coef.size() << std::setw(12) << w_coef << std::setw(12) << r_coef << "\n";
+		std::cout.unsetf(std::ios::floatfield);
+		tot[0] += w_raw;
+		tot[1] += r_raw;
+		tot[2] += w_coef;
+		tot[3] += r_coef;
+	}
+	std::cout << std::fixed << std::setprecision(3) << "total     write raw " << tot[0] << " coef " << tot[2]
+			  << ", read raw " << tot[1] << " coef " << tot[3] << "\n";
+	return 0;
+}
+
 int main(int argc, char** argv) {
 	if (argc < 3) {
 		usage(argv[0]);
@@ -76,23 +442,125 @@ int main(int argc, char** argv) {
 
 	const char* input = argv[1];
 	int tar = std::atoi(argv[2]);
-	if (tar != 0 && tar != 1) {
+	if (tar < 0 || tar > 5) {
 		std::cerr << "Invalid tar: " << argv[2] << "\n";
 		usage(argv[0]);
 		return 1;
 	}
 	std::string output_path;
-	if (tar == 1) {
+	Npy_options npy;
+	Resample::Grid grid;
+	std::string cache_dir = Observables::Cache::default_dir();
+	if (tar == 5) {
+		int repeat = argc >= 4 ? std::atoi(argv[3]) : 20;
+		try {
+			return run_bench(input, std::max(repeat, 1));
+		} catch (const std::exception& e) {
+			std::cerr << "reader failed: " << e.what() << "\n";
+			return 1;
+		}
+	} else if (tar == 4) {
+		output_path = "observables.csv";
+		int jobs = 0;
+		for (int i = 3; i < argc; ++i) {
+			if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+				jobs = std::atoi(argv[++i]);
+			else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+				cache_dir = argv[++i];
+			else if (std::strcmp(argv[i], "--no-cache") == 0)
+				cache_dir.clear();
+			else
+				output_path = argv[i];
+		}
+		try {
+			std::unique_ptr<Observables::Cache> cache;
+			if (!cache_dir.empty())
+				cache.reset(new Observables::Cache(cache_dir));
+			return run_batch(input, output_path, jobs, cache.get());
+		} catch (const std::exception& e) {
+			std::cerr << "reader failed: " << e.what() << "\n";
+			return 1;
+		}
+	} else if (tar == 0) {
+		for (int i = 3; i < argc; ++i) {
+			if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+				cache_dir = argv[++i];
+			else if (std::strcmp(argv[i], "--no-cache") == 0)
+				cache_dir.clear();
+		}
+	} else if (tar == 1) {
 		if (argc >= 4)
 			output_path = argv[3];
 		else
 			output_path = default_output_path(input);
+	} else if (tar == 2) {
+		output_path = default_npy_dir(input);
+		for (int i = 3; i < argc; ++i) {
+			if (std::strcmp(argv[i], "--f32") == 0)
+				npy.f32 = true;
+			else if (std::strcmp(argv[i], "--coef") == 0)
+				npy.coef = true;
+			else
+				output_path = argv[i];
+		}
+	} else if (tar == 3) {
+		if (argc < 10 || (std::strcmp(argv[3], "polar") != 0 && std::strcmp(argv[3], "cart") != 0)) {
+			usage(argv[0]);
+			return 1;
+		}
+		grid.cartesian = std::strcmp(argv[3], "cart") == 0;
+		grid.n1 = std::atoi(argv[4]);
+		grid.a0 = std::atof(argv[5]);
+		grid.a1 = std::atof(argv[6]);
+		grid.n2 = std::atoi(argv[7]);
+		grid.b0 = std::atof(argv[8]);
+		grid.b1 = std::atof(argv[9]);
+		if (grid.n1 <= 0 || grid.n2 <= 0 || (!grid.cartesian && (grid.a0 < 0 || grid.a1 < 0))) {
+			std::cerr << "Invalid grid\n";
+			return 1;
+		}
+		output_path = default_npy_dir(input, "_grid");
+		for (int i = 10; i < argc; ++i) {
+			if (std::strcmp(argv[i], "--f32") == 0)
+				npy.f32 = true;
+			else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+				npy.threads = std::atoi(argv[++i]);
+			else if (std::strcmp(argv[i], "--fields") == 0 && i + 1 < argc) {
+				std::string list = argv[++i];
+				size_t start = 0;
+				while (start <= list.size()) {
+					size_t end = list.find(',', start);
+					if (end == std::string::npos)
+						end = list.size();
+					if (end > start)
+						npy.only.push_back(list.substr(start, end - start));
+					start = end + 1;
+				}
+			} else
+				output_path = argv[i];
+		}
 	}
 
 	try {
+		if (tar == 0) {
+			// 计算模式只需要物理量：缓存命中时连场都不读
+			Observables::Values v;
+			bool hit = false;
+			if (!cache_dir.empty()) {
+				v = Observables::Cache(cache_dir).get(input, &hit);
+			} else {
+				Io::Solution sol = Io::read_solution(input);
+				v = Observables::compute(sol);
+			}
+			std::cout << "mode      = compute" << (hit ? " (cached)" : "") << "\n";
+			std::cout << "data_type = " << (v.kind == SolutionKind::Axisymmetric ? "axisymmetric" : "spherical") << "\n";
+			print_values(v);
+			return 0;
+		}
+
 		int kk_guess = 0;
 		SolutionKind kind = Io::detect_kind(input, kk_guess);
-		std::cout << "mode      = " << (tar == 0 ? "compute" : "export") << "\n";
+		std::cout << "mode      = " << (tar == 1 ? "export" : (tar == 2 ? "export-npy" : "resample")) << "\n";
 		std::cout << "data_type = " << (kind == SolutionKind::Axisymmetric ? "axisymmetric" : "spherical") << "\n";
 
 		if (kind == SolutionKind::Axisymmetric) {
@@ -119,44 +587,15 @@ int main(int argc, char** argv) {
 			Scalar bt(incbt.div_rsint());
 			bt.std_base();
 
-			if (tar == 0) {
-				int ndom = space.get_nbr_domains();
-
-				Val_domain integadm(A(ndom - 1).der_r());
-				double Madm = -space.get_domain(ndom - 1)->integ(integadm, OUTER_BC) / 4 / M_PI;
-
-				Val_domain integkomar(ap(ndom - 1).der_r());
-				double Mkomar = space.get_domain(ndom - 1)->integ(integkomar, OUTER_BC) / 4 / M_PI;
-
-				Val_domain auxiJs(bt(ndom - 1).der_r_rtwo());
-				Val_domain integJs(auxiJs.mult_sin_theta().mult_sin_theta());
-				double Js = -space.get_domain(ndom - 1)->integ(integJs, OUTER_BC) / 16 / M_PI;
-
-				Scalar auxiJv(kk * (omega - bt * kk) * phi * phi / ap * A * A * B);
-				Scalar integJv(space);
-				for (int d = 0; d < ndom; d++)
-					integJv.set_domain(d) = auxiJv(d).mult_r().mult_sin_theta();
-				double Jv = 0;
-				for (int d = 0; d < ndom; d++)
-					Jv += space.get_domain(d)->integ_volume(integJv(d));
-				Jv *= 2 * M_PI;
-
-				std::cout << "Axisymmetric boson star\n";
-				std::cout << "k        = " << kk << "\n";
-				std::cout << "omega    = " << omega << "\n";
-				std::cout << "lambda   = " << lambda << "\n";
-				std::cout << "Madm     = " << Madm << "\n";
-				std::cout << "Mkomar   = " << Mkomar << "\n";
-				std::cout << "Js       = " << Js << "\n";
-				std::cout << "Jv       = " << Jv << "\n";
-				std::cout << "diff Komar ADM = " << fabs(Madm - Mkomar) / fabs(Madm + Mkomar) << "\n";
-				std::cout << "diff Js and Jv = " << fabs(Js - Jv) / fabs(Js + Jv) << "\n";
-			} else {
-				std::vector<std::string> names = {"ap", "A", "B", "bt", "phi"};
-				std::vector<const Scalar*> fields = {&ap, &A, &B, &bt, &phi};
+			std::vector<std::string> names = {"ap", "A", "B", "bt", "phi"};
+			std::vector<const Scalar*> fields = {&ap, &A, &B, &bt, &phi};
+			if (tar == 3)
+				write_grid_dir(output_path, space, grid, kk, omega, lambda, names, fields, npy);
+			else if (tar == 2)
+				write_npy_dir(output_path, space, kk, omega, lambda, names, fields, npy);
+			else
 				write_txt(output_path, space, omega, lambda, names, fields);
-				std::cout << "exported: " << output_path << "\n";
-			}
+			std::cout << "exported: " << output_path << "\n";
 		});
 		} else {
 			Io::load_spherical(input, 0.0, [&](const Space_polar& space,
@@ -165,36 +604,22 @@ int main(int argc, char** argv) {
 							   const Scalar& psi,
 							   const Scalar& nu,
 							   const Scalar& phi,
-							   bool has_lambda) {
+							   bool /*has_lambda*/) {
 				Scalar Psi(exp(psi));
 				Psi.std_base();
 
 				Scalar N(exp(nu));
 				N.std_base();
 
-				if (tar == 0) {
-					int ndom = space.get_nbr_domains();
-					Scalar A(Psi * Psi * Psi *Psi);
-					A.std_base();
-
-					Val_domain integadm(A(ndom - 1).der_r());
-					double Madm = -space.get_domain(ndom - 1)->integ(integadm, OUTER_BC) / 4 / M_PI;
-
-					Val_domain integkomar(N(ndom - 1).der_r());
-					double Mkomar = space.get_domain(ndom - 1)->integ(integkomar, OUTER_BC) / 4 / M_PI;
-
-					std::cout << "Spherical solution\n";
-					std::cout << "omega    = " << omega << "\n";
-					std::cout << "lambda   = " << lambda << (has_lambda ? " (file)" : " (assumed)") << "\n";
-					std::cout << "Madm     = " << Madm << "\n";
-					std::cout << "Mkomar   = " << Mkomar << "\n";
-					std::cout << "diff Komar ADM = " << fabs(Madm - Mkomar) / fabs(Madm + Mkomar) << "\n";
-				} else {
-					std::vector<std::string> names = {"Psi", "N", "phi"};
-					std::vector<const Scalar*> fields = {&Psi, &N, &phi};
+				std::vector<std::string> names = {"Psi", "N", "phi"};
+				std::vector<const Scalar*> fields = {&Psi, &N, &phi};
+				if (tar == 3)
+					write_grid_dir(output_path, space, grid, -1, omega, lambda, names, fields, npy);
+				else if (tar == 2)
+					write_npy_dir(output_path, space, -1, omega, lambda, names, fields, npy);
+				else
 					write_txt(output_path, space, omega, lambda, names, fields);
-					std::cout << "exported: " << output_path << "\n";
-				}
+				std::cout << "exported: " << output_path << "\n";
 			});
 		}
 
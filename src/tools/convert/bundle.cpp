@@ -0,0 +1,130 @@
+#include "utils/bundle.hpp"
+#include "utils/io_commons.hpp"
+#include "utils/regrid.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace Kadath;
+using Io::SolutionKind;
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " list <bundle>\n";
+    std::cerr << "       " << prog << " extract <bundle> <id|all> [output_dir]\n";
+    std::cerr << "       " << prog << " append <bundle> [--full] [--keyframe N] [--trim tol] [--native] <solution.dat>...\n";
+    std::cerr << "  append creates the bundle from the first file when it does not exist;\n";
+    std::cerr << "  all solutions of a bundle must share the same grid\n";
+}
+
+static std::string record_name(const Bundle::Archive& b, const Bundle::Entry& e) {
+    char name[128];
+    if (b.kind() == SolutionKind::Axisymmetric)
+        snprintf(name, sizeof(name), "bos_%d_%.12g_%.12g.dat", e.kk, e.omega, e.lambda);
+    else
+        snprintf(name, sizeof(name), "boson_star_lam%.12g_om%.12g.dat", e.lambda, e.omega);
+    return name;
+}
+
+static int list(const std::string& path) {
+    Bundle::Archive b(path);
+    std::cout << "# " << path << ": " << (b.kind() == SolutionKind::Axisymmetric ? "axisymmetric" : "spherical")
+              << ", " << b.size() << " records, grid " << Regrid::grid_key(b.space()) << "\n";
+    std::cout << "# id kk omega lambda base bytes\n";
+    for (const Bundle::Entry& e : b.entries()) {
+        char line[160];
+        snprintf(line, sizeof(line), "%d %d %.17g %.17g %d %llu", e.id, e.kk, e.omega, e.lambda, e.base,
+                 (unsigned long long)e.size);
+        std::cout << line << "\n";
+    }
+    return 0;
+}
+
+static int extract(const std::string& path, const std::string& which, const std::string& dir) {
+    Bundle::Archive b(path);
+    int first = 0;
+    int last = b.size() - 1;
+    if (which != "all") {
+        first = last = std::atoi(which.c_str());
+        if (first < 0 || first >= b.size())
+            throw std::runtime_error("no record " + which + " in " + path);
+    }
+    for (int id = first; id <= last; id++) {
+        const Bundle::Entry& e = b.entries()[id];
+        const Bundle::Archive::Fields& f = b.load(id);
+        std::string out = (dir.empty() ? std::string() : dir + "/") + record_name(b, e);
+        if (b.kind() == SolutionKind::Axisymmetric)
+            Io::save_axisymmetric(out.c_str(), b.space(), e.kk, e.omega, e.lambda, *f[0], *f[1], *f[2], *f[3], *f[4]);
+        else
+            Io::save_spherical(out.c_str(), b.space(), e.omega, e.lambda, *f[0], *f[1], *f[2]);
+        std::cerr << "record " << id << " -> " << out << "\n";
+    }
+    return 0;
+}
+
+static int append(const std::string& path, int argc, char** argv, int start) {
+    Bundle::Options opts;
+    std::vector<std::string> inputs;
+    for (int i = start; i < argc; i++) {
+        if (std::strcmp(argv[i], "--full") == 0)
+            opts.delta = false;
+        else if (std::strcmp(argv[i], "--keyframe") == 0 && i + 1 < argc)
+            opts.keyframe = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--trim") == 0 && i + 1 < argc)
+            opts.trim_tol = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--native") == 0)
+            opts.native = true;
+        else
+            inputs.push_back(argv[i]);
+    }
+    if (inputs.empty())
+        throw std::runtime_error("nothing to append");
+
+    if (access(path.c_str(), F_OK) != 0) {
+        int kk_guess = 0;
+        SolutionKind kind = Io::detect_kind(inputs[0].c_str(), kk_guess);
+        Bundle::Archive::create(path, *Io::read_space(inputs[0].c_str()), kind);
+        std::cerr << "created " << path << "\n";
+    }
+    Bundle::Archive b(path, nullptr, true);
+    std::string key = Regrid::grid_key(b.space());
+    for (const std::string& in : inputs) {
+        if (Regrid::grid_key(*Io::read_space(in.c_str())) != key)
+            throw std::runtime_error(in + " is not on the bundle grid (regrid it first)");
+        Io::Solution sol = Io::read_solution(in.c_str(), {}, &b.space());
+        if (sol.kind != b.kind())
+            throw std::runtime_error(in + " is not the same kind of solution as the bundle");
+        std::vector<const Scalar*> fields;
+        for (const std::unique_ptr<Scalar>& s : sol.fields)
+            fields.push_back(s.get());
+        int id = b.append(sol.kk, sol.omega, sol.lambda, fields, opts);
+        std::cerr << in << " -> record " << id << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string cmd = argv[1];
+    std::string path = argv[2];
+    try {
+        if (cmd == "list")
+            return list(path);
+        if (cmd == "extract" && argc >= 4)
+            return extract(path, argv[3], argc >= 5 ? argv[4] : "");
+        if (cmd == "append")
+            return append(path, argc, argv, 3);
+    } catch (const std::exception& e) {
+        std::cerr << "bundle failed: " << e.what() << "\n";
+        return 1;
+    }
+    usage(argv[0]);
+    return 1;
+}
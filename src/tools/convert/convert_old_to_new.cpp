@@ -1,71 +1,137 @@
+#include "utils/batch_files.hpp"
 #include "utils/io_commons.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
-#include <sstream>
-#include <iomanip>
+#include <unistd.h>
+#include <vector>
 
 using namespace Kadath;
 using Io::SolutionKind;
 
-int main(int argc, char** argv) {
-    (void)argc;
-    (void)argv;
+// 旧格式（顺序写、可能缺 lambda）批量转为带索引的新格式。
+// 每个文件只打开解析一次（Io::read_solution），Io::save_* 写到临时文件后 rename，中途被杀或磁盘满不会留下半个输出；
+// 已是新格式的文件跳过。Kadath 不是线程安全的，并行用 fork 出的工作进程（Batch_files::run）。
+
+struct Convert_options {
+    std::string out_dir;          // 输出目录；为空时须给 --in-place
+    bool in_place = false;        // 原地转换（覆盖输入），须显式给出
+    bool override_lambda = false; // 强制写入 lambda_override，否则旧文件无 lambda 时补 lambda_override
+    double lambda_override = 0.0;
+    int jobs = 0;                 // 工作进程数，0 为 CPU 核数
+    Io::Format format = Io::Format::Indexed;   // --native 时为 Native
+};
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " (--out dir | --in-place) [--lambda L] [--jobs N] [--native] <file|dir|'glob'|@list.txt>...\n";
+    std::cerr << "  converts legacy solutions to the indexed format, into dir or, with --in-place, over the inputs;\n";
+    std::cerr << "  files already in the indexed format are skipped. --lambda forces the written lambda,\n";
+    std::cerr << "  otherwise files without lambda get 0. --native stores coefficients in host byte order\n";
+}
+
+static bool is_converted(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f)
+        return false;
+    bool indexed = Io::detail::is_indexed(f);
+    fclose(f);
+    return indexed;
+}
 
-    // 配置：在此修改输入/输出文件和可选的 lambda 覆盖值
-    const char* input = "/home/chenhuhuhu/vscodedev/src/historydata/bos_1_0.798905.dat";                // 旧格式输入文件
-    std::string output = "/home/chenhuhuhu/vscodedev/src/tools/converted/bos_1_0.798905_0.dat"; // 转换后输出文件
-    bool override_lambda = false;                      // 设为 true 可强制覆盖 lambda_override
-    double lambda_override = 0.0;                      // 覆盖的 lambda 值
+static std::string output_for(const std::string& input, const Convert_options& opt) {
+    if (opt.out_dir.empty())
+        return input;
+    size_t slash = input.rfind('/');
+    return opt.out_dir + "/" + (slash == std::string::npos ? input : input.substr(slash + 1));
+}
 
+// 返回一行 "<状态>\t<说明>"，状态为 converted / skipped / failed
+static std::string convert_one(const std::string& input, const Convert_options& opt) {
+    std::string output = output_for(input, opt);
     try {
-        std::cerr << "Reading input: " << input << "\n";
-        int kk_guess = 0;
-        SolutionKind kind = Io::detect_kind(input, kk_guess);
-        std::cerr << "Detected kind: " << (kind == SolutionKind::Axisymmetric ? "axisymmetric" : "spherical")
-                  << ", kk_guess=" << kk_guess << "\n";
+        if (is_converted(output))
+            return "skipped\t" + input + (output == input ? "" : " (" + output + " exists)");
+        Io::Solution sol = Io::read_solution(input.c_str(), {}, nullptr, opt.lambda_override);
+        double lambda_out = opt.override_lambda ? opt.lambda_override : sol.lambda;
+        if (sol.kind == SolutionKind::Axisymmetric)
+            Io::save_axisymmetric(output.c_str(), *sol.space, sol.kk, sol.omega, lambda_out, sol.field("nu"),
+                                  sol.field("incA"), sol.field("incB"), sol.field("incbt"), sol.field("phi"), opt.format);
+        else
+            Io::save_spherical(output.c_str(), *sol.space, sol.omega, lambda_out, sol.field("psi"), sol.field("nu"),
+                               sol.field("phi"), opt.format);
+        char info[160];
+        if (sol.kind == SolutionKind::Axisymmetric)
+            snprintf(info, sizeof(info), " (axisymmetric kk=%d omega=%.12g lambda=%.12g%s)", sol.kk, sol.omega,
+                     lambda_out, sol.has_lambda ? "" : " added");
+        else
+            snprintf(info, sizeof(info), " (spherical omega=%.12g lambda=%.12g%s)", sol.omega, lambda_out,
+                     sol.has_lambda ? "" : " added");
+        return "converted\t" + input + " -> " + output + info;
+    } catch (const std::exception& e) {
+        return "failed\t" + input + ": " + e.what();
+    }
+}
 
-        if (kind == SolutionKind::Axisymmetric) {
-            std::cerr << "Loading axisymmetric solution..." << std::endl;
-            Io::load_axisymmetric(input, lambda_override, [&](const Space_polar& space,
-                                                             int kk,
-                                                             double omega,
-                                                             double lambda,
-                                                             const Scalar& nu,
-                                                             const Scalar& incA,
-                                                             const Scalar& incB,
-                                                             const Scalar& incbt,
-                                                             const Scalar& phi,
-                                                             bool has_lambda) {
-                std::cerr << "Axisymmetric load complete. Saving..." << std::endl;
-                double lambda_out = override_lambda ? lambda_override : (has_lambda ? lambda : 0.0);
-                Io::save_axisymmetric(output.c_str(), space, kk, omega, lambda_out, nu, incA, incB, incbt, phi);
-                std::cerr << "Converted axisymmetric file: kk=" << kk
-                          << " omega=" << omega
-                          << " lambda=" << lambda_out
-                          << " -> " << output << "\n";
-            });
-        } else {
-            std::cerr << "Loading spherical solution..." << std::endl;
-            Io::load_spherical(input, lambda_override, [&](const Space_polar& space,
-                                                           double omega,
-                                                           double lambda,
-                                                           const Scalar& psi,
-                                                           const Scalar& nu,
-                                                           const Scalar& phi,
-                                                           bool has_lambda) {
-                std::cerr << "Spherical load complete. Saving..." << std::endl;
-                double lambda_out = override_lambda ? lambda_override : (has_lambda ? lambda : 0.0);
-                Io::save_spherical(output.c_str(), space, omega, lambda_out, psi, nu, phi);
-                std::cerr << "Converted spherical file: omega=" << omega
-                          << " lambda=" << lambda_out
-                          << " -> " << output << "\n";
-            });
-        }
+int main(int argc, char** argv) {
+    Convert_options opt;
+    std::vector<std::string> specs;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            opt.out_dir = argv[++i];
+        else if (std::strcmp(argv[i], "--in-place") == 0)
+            opt.in_place = true;
+        else if (std::strcmp(argv[i], "--lambda") == 0 && i + 1 < argc) {
+            opt.override_lambda = true;
+            opt.lambda_override = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            opt.jobs = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--native") == 0)
+            opt.format = Io::Format::Native;
+        else
+            specs.push_back(argv[i]);
+    }
+    // 原地转换会覆盖旧格式的唯一副本，须显式要求
+    if (specs.empty() || opt.out_dir.empty() == !opt.in_place) {
+        usage(argv[0]);
+        return 1;
+    }
 
+    std::vector<std::string> files;
+    try {
+        for (const std::string& spec : specs) {
+            std::vector<std::string> found = Batch_files::expand(spec);
+            if (found.empty())
+                std::cerr << "no files match " << spec << "\n";
+            files.insert(files.end(), found.begin(), found.end());
+        }
+        if (!opt.out_dir.empty() && mkdir(opt.out_dir.c_str(), 0755) != 0 && errno != EEXIST)
+            throw std::runtime_error("cannot create " + opt.out_dir);
     } catch (const std::exception& e) {
         std::cerr << "Conversion failed: " << e.what() << "\n";
         return 1;
     }
 
-    return 0;
+    std::string scratch = (opt.out_dir.empty() ? std::string(".") : opt.out_dir) + "/.convert_old_to_new."
+        + std::to_string(getpid());
+    std::vector<std::string> results = Batch_files::run(files.size(), opt.jobs, scratch,
+                                                        [&](size_t i) { return convert_one(files[i], opt); });
+
+    int nconv = 0;
+    int nskip = 0;
+    int nfail = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        std::string& r = results[i];
+        if (r.empty())
+            r = "failed\t" + files[i] + ": worker died";
+        size_t tab = r.find('\t');
+        std::string status = r.substr(0, tab);
+        (status == "converted" ? nconv : (status == "skipped" ? nskip : nfail))++;
+        (status == "failed" ? std::cerr : std::cout) << status << " " << r.substr(tab + 1) << "\n";
+    }
+    std::cout << "Converted " << nconv << ", skipped " << nskip << ", failed " << nfail << " of " << files.size()
+              << " files\n";
+    return nfail == 0 ? 0 : 1;
 }
@@ -0,0 +1,98 @@
+#include "utils/io_commons.hpp"
+#include "utils/axi_session.hpp"
+#include "utils/regrid.hpp"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+using namespace Kadath;
+using Io::SolutionKind;
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " <input.dat> <output.dat> <resol> <bound_1> ... <bound_n>\n";
+    std::cerr << "  spectrally interpolates a stored solution onto a new Space_polar\n";
+    std::cerr << "  with ndom = n+1 domains (the last one compactified)\n";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char* input = argv[1];
+    const char* output = argv[2];
+    int resol = std::atoi(argv[3]);
+    int nbounds = argc - 4;
+    if (resol < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Array<double> bounds(nbounds);
+    for (int i = 0; i < nbounds; i++)
+        bounds.set(i) = std::atof(argv[4 + i]);
+    Point center(2);
+    center.set(1) = 0;
+    center.set(2) = 0;
+
+    try {
+        int kk_guess = 0;
+        SolutionKind kind = Io::detect_kind(input, kk_guess);
+
+        if (kind == SolutionKind::Axisymmetric) {
+            Io::load_axisymmetric(input, 0.0, [&](const Space_polar& /*space*/,
+                                                  int kk,
+                                                  double omega,
+                                                  double lambda,
+                                                  const Scalar& nu,
+                                                  const Scalar& incA,
+                                                  const Scalar& incB,
+                                                  const Scalar& incbt,
+                                                  const Scalar& phi,
+                                                  bool /*has_lambda*/) {
+                Dim_array res(2);
+                res.set(0) = resol;
+                res.set(1) = resol;
+                Space_polar target(CHEB_TYPE, center, res, bounds);
+                Scalar rsint(Axi::make_rsint(target));
+                Scalar nu_new(Regrid::transfer(nu, Regrid::std_like(target)));
+                Scalar incA_new(Regrid::transfer(incA, Regrid::std_like(target)));
+                Scalar incB_new(Regrid::transfer(incB, rsint));
+                Scalar incbt_new(Regrid::transfer(incbt, rsint));
+                Scalar phi_new(Regrid::transfer(phi, Regrid::std_like(target, kk)));
+                Io::save_axisymmetric(output, target, kk, omega, lambda,
+                                      nu_new, incA_new, incB_new, incbt_new, phi_new);
+                std::cerr << "Regridded axisymmetric solution: kk=" << kk
+                          << " omega=" << omega << " lambda=" << lambda
+                          << " resol=" << resol << " ndom=" << nbounds + 1
+                          << " -> " << output << "\n";
+            });
+        } else {
+            Io::load_spherical(input, 0.0, [&](const Space_polar& /*space*/,
+                                               double omega,
+                                               double lambda,
+                                               const Scalar& psi,
+                                               const Scalar& nu,
+                                               const Scalar& phi,
+                                               bool /*has_lambda*/) {
+                Dim_array res(2);
+                res.set(0) = resol;
+                res.set(1) = 1;
+                Space_polar target(CHEB_TYPE, center, res, bounds);
+                Scalar psi_new(Regrid::transfer(psi, Regrid::std_like(target)));
+                Scalar nu_new(Regrid::transfer(nu, Regrid::std_like(target)));
+                Scalar phi_new(Regrid::transfer(phi, Regrid::std_like(target)));
+                Io::save_spherical(output, target, omega, lambda, psi_new, nu_new, phi_new);
+                std::cerr << "Regridded spherical solution: omega=" << omega
+                          << " lambda=" << lambda
+                          << " resol=" << resol << " ndom=" << nbounds + 1
+                          << " -> " << output << "\n";
+            });
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Regrid failed: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Adapt {
+
+// 由谱系数的衰减估计所需分辨率。
+// 每个场每个域取沿径向（与角向）的系数包络 e_n = max_其余下标 |c| / max|c|，对高于舍入平台的后半段
+// 做 log e_n 的线性拟合得到每阶的衰减率，外推出包络降到 target 所需的系数个数。
+// Space_polar 的构造只接受所有域相同的分辨率，故取各域估计的最大值作为全局分辨率；各域的估计照样报告，
+// 便于判断是否该调整域的划分。
+struct Options {
+    double target = 1e-10;   // 目标截断误差（相对该场该域的最大系数）
+    int min_resol = 9;
+    int max_resol = 33;
+    double floor = 1e-14;    // 舍入平台，低于此的系数不参与拟合
+};
+
+struct Report {
+    std::vector<int> needed;     // 各域所需分辨率（所有场中最大）
+    std::vector<double> tail;    // 各域末端系数的相对大小（所有场中最大）
+    int current = 0;
+    int resol = 0;               // 建议的全局分辨率（奇数，限制在 [min_resol, max_resol]）
+
+    bool changed() const { return resol != current; }
+};
+
+namespace detail {
+
+// 一条包络所需的系数个数
+inline double needed_for(const std::vector<double>& e, const Options& opt) {
+    int n = int(e.size());
+    if (n < 3)
+        return n;
+    double last = std::max(std::max(e[n - 1], e[n - 2]), 1e-300);
+    // 后半段中高于舍入平台的点做最小二乘
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int m = 0;
+    for (int i = n / 2; i < n; i++)
+        if (e[i] > opt.floor) {
+            double y = std::log(e[i]);
+            sx += i;
+            sy += y;
+            sxx += double(i) * i;
+            sxy += i * y;
+            m++;
+        }
+    if (m < 2) {
+        // 后半段已在舍入平台：取最后一个高于 target 的系数
+        int i = n - 1;
+        while (i > 0 && e[i] <= opt.target)
+            i--;
+        return i + 1;
+    }
+    double slope = (m * sxy - sx * sy) / (m * sxx - sx * sx);
+    if (!(slope < -1e-3))
+        return last <= opt.target ? n : 2.0 * n;  // 不衰减：未分辨，加倍
+    return (n - 1) + (std::log(opt.target) - std::log(last)) / slope + 1;
+}
+
+} // namespace detail
+
+inline Report assess(const Kadath::Space_polar& space, const std::vector<const Kadath::Scalar*>& fields,
+                     const Options& opt = Options()) {
+    int ndom = space.get_nbr_domains();
+    Report rep;
+    rep.current = space.get_domain(0)->get_nbr_points()(0);
+    rep.needed.assign(ndom, opt.min_resol);
+    rep.tail.assign(ndom, 0.0);
+    for (int d = 0; d < ndom; d++) {
+        Kadath::Dim_array dims(space.get_domain(d)->get_nbr_coefs());
+        int nr = dims(0);
+        int nt = dims.get_ndim() > 1 ? dims(1) : 1;
+        for (const Kadath::Scalar* s : fields) {
+            const Kadath::Val_domain& v = (*s)(d);
+            if (v.check_if_zero())
+                continue;
+            v.coef();
+            std::vector<double> er(nr, 0.0), et(nt, 0.0);
+            double cmax = 0;
+            Kadath::Index idx(dims);
+            do {
+                double c = std::fabs(v.get_coef()(idx));
+                er[idx(0)] = std::max(er[idx(0)], c);
+                if (nt > 1)
+                    et[idx(1)] = std::max(et[idx(1)], c);
+                cmax = std::max(cmax, c);
+            } while (idx.inc());
+            if (cmax == 0)
+                continue;
+            for (double& e : er)
+                e /= cmax;
+            for (double& e : et)
+                e /= cmax;
+            double need = detail::needed_for(er, opt);
+            double tail = std::max(er[nr - 1], nr > 1 ? er[nr - 2] : 0.0);
+            if (nt > 2) {
+                // 角向系数个数与径向的比例随基底而定，按同一比例折算为分辨率
+                need = std::max(need, detail::needed_for(et, opt) * double(nr) / nt);
+                tail = std::max(tail, std::max(et[nt - 1], et[nt - 2]));
+            }
+            // 系数个数折算为配置点数（两者之比在 Kadath 的基底中固定）
+            int points = space.get_domain(d)->get_nbr_points()(0);
+            int resol = int(std::ceil(need * double(points) / nr));
+            rep.needed[d] = std::max(rep.needed[d], resol);
+            rep.tail[d] = std::max(rep.tail[d], tail);
+        }
+    }
+    int r = *std::max_element(rep.needed.begin(), rep.needed.end());
+    // 降分辨率留出余量，避免在相邻两个分辨率之间来回切换
+    if (r < rep.current && r > rep.current - 4)
+        r = rep.current;
+    r = std::min(std::max(r, opt.min_resol), opt.max_resol);
+    if (r % 2 == 0)
+        r = std::min(r + 1, opt.max_resol % 2 ? opt.max_resol : opt.max_resol - 1);
+    rep.resol = r;
+    return rep;
+}
+
+} // namespace Adapt
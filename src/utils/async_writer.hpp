@@ -0,0 +1,98 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+namespace Async {
+
+// 后台落盘：调用方先把解序列化成字节（如 Io::encode_axisymmetric，Kadath 调用留在调用线程），
+// submit 后立即返回；后台线程依次写到 <path>.tmp、fsync 后 rename，读者不会看到写了一半的文件。
+// 队列最多 max_pending 个文件，满时 submit 阻塞（限制内存）；drain 等队列清空，析构时自动 drain。
+class Writer {
+public:
+    explicit Writer(size_t max_pending = 4) : max_pending_(max_pending), thread_([this] { loop(); }) {}
+
+    ~Writer() {
+        drain();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    void submit(const std::string& path, std::string bytes) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return queue_.size() < max_pending_; });
+        queue_.emplace_back(path, std::move(bytes));
+        cv_.notify_all();
+    }
+
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return queue_.empty() && !busy_; });
+    }
+
+    // 写失败的文件数（错误信息已打印到 stderr）
+    int failures() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return failures_;
+    }
+
+private:
+    static bool write_file(const std::string& path, const std::string& bytes) {
+        std::string tmp = path + ".tmp";
+        FILE* f = fopen(tmp.c_str(), "wb");
+        if (!f)
+            return false;
+        bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size() && fflush(f) == 0 && fsync(fileno(f)) == 0;
+        ok = fclose(f) == 0 && ok;
+        if (ok && rename(tmp.c_str(), path.c_str()) == 0)
+            return true;
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;
+            std::pair<std::string, std::string> job = std::move(queue_.front());
+            queue_.pop_front();
+            busy_ = true;
+            lock.unlock();
+            bool ok = write_file(job.first, job.second);
+            if (!ok)
+                std::cerr << "Async::Writer: failed to write " << job.first << std::endl;
+            lock.lock();
+            busy_ = false;
+            if (!ok)
+                failures_++;
+            cv_.notify_all();
+        }
+    }
+
+    size_t max_pending_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::pair<std::string, std::string>> queue_;
+    bool busy_ = false;
+    bool stop_ = false;
+    int failures_ = 0;
+    std::thread thread_;
+};
+
+} // namespace Async
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include "mpi.h"
+#include "utils/axi_session.hpp"
+#include "utils/chord_newton.hpp"
+#include "utils/jfnk.hpp"
+#include "utils/regrid.hpp"
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace Axi {
+
+// 以粗网格精确 Jacobian 为预条件子的 JFNK 求解（用法：构造后 session.solve / session.newton 即走 JFNK）。
+// 粗网格系统是同一会话的镜像（参数与点约束绑定相同变量），方程带源项 eqX - srcX，外边界条件带 X - bsrcX：
+//   限制：残差的方程场与边界条件的场（即各未知场）谱插值到粗网格作为源项，F_c(x_c; 0) - F_c(x_c; src)
+//         即粗网格残差向量；点约束各占一行且在两个系统中位置相同，直接取细网格残差的对应分量；
+//   求解：粗 Jacobian 的 LU，在限制后的状态上装配，跨 Newton 步复用，收缩率超过 refresh_rate、
+//         GMRES 未达 forcing 或中断后重新装配；
+//   延拓：粗修正量经 newton_update_vars 转为场，再谱插值回细网格。
+// GMRES 中断时本步改用细网格的完整 Newton 步。
+class Jfnk_solver {
+public:
+    Jfnk_solver(Session& fine, ::Jfnk::Options opts = ::Jfnk::Options())
+        : fine_(fine), opts_(opts) {
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
+        if (fine.model() != Model::Full || fine.has_frozen())
+            throw std::runtime_error("Jfnk_solver: only the full five-field model is supported");
+        coarse_space_ = Regrid::with_resol(fine.space(), opts.resol_coarse);
+        // 粗网格模板与 rbs 中的初值相同：incB / incbt 取 rsint 的基底，phi 带 m 量子数
+        Kadath::Scalar rsint(make_rsint(*coarse_space_));
+        rsint.annule_hard();
+        coarse_fields_.emplace_back(new Kadath::Scalar(Regrid::std_like(*coarse_space_)));
+        coarse_fields_.emplace_back(new Kadath::Scalar(Regrid::std_like(*coarse_space_)));
+        coarse_fields_.emplace_back(new Kadath::Scalar(rsint));
+        coarse_fields_.emplace_back(new Kadath::Scalar(rsint));
+        coarse_fields_.emplace_back(new Kadath::Scalar(Regrid::std_like(*coarse_space_, fine.kk())));
+        omega_c_ = fine.omega();
+        double& omega_ref = fine.omega_unknown() ? omega_c_ : fine.omega();
+        coarse_ = fine.mirror(*coarse_space_, *coarse_fields_[0], *coarse_fields_[1], *coarse_fields_[2],
+                              *coarse_fields_[3], *coarse_fields_[4], omega_ref);
+        coarse_->use_sources();
+
+        std::vector<double*> values;
+        if (fine.omega_unknown())
+            values.push_back(&fine.omega());
+        engine_.reset(new ::Jfnk::Engine(fine.system(), fine.fields(), values, Session::eq_names(),
+                                         [this](const std::vector<double>& v, const std::vector<Kadath::Scalar>& r,
+                                                ::Jfnk::Delta& z) { precondition(v, r, z); },
+                                         opts));
+        fine.use_stepper([this](double prec, double& conv) { return step(prec, conv); });
+    }
+
+    Jfnk_solver(const Jfnk_solver&) = delete;
+    Jfnk_solver& operator=(const Jfnk_solver&) = delete;
+
+    ~Jfnk_solver() { fine_.use_stepper(nullptr); }
+
+    int nbr_krylov() const { return engine_->nbr_krylov(); }
+    int nbr_factorizations() const { return nfact_; }
+
+private:
+    bool step(double prec, double& conv) {
+        coarse_->sync();
+        coarse_->clear_sources();
+        Kadath::System_of_eqs& cs = coarse_->system();
+        if (refresh_ || jac_.empty()) {
+            // 粗网格状态取细网格当前解的限制，在此状态上装配分解 Jacobian；之后粗网格状态保持不变
+            std::vector<Kadath::Scalar*> fine_fields = fine_.fields();
+            for (size_t i = 0; i < fine_fields.size(); i++)
+                *coarse_fields_[i] = Regrid::transfer(*fine_fields[i], *coarse_fields_[i]);
+            if (fine_.omega_unknown())
+                omega_c_ = fine_.omega();
+            nfact_++;
+            refresh_ = false;
+            if (!jac_.assemble(cs))
+                return full_step(prec, conv, "singular coarse Jacobian");
+        }
+        // 参数（如扫描中的 omega / lambda）可能已变，F_c(x_c; 0) 每步重算
+        cs.vars_to_terms();
+        Kadath::Array<double> f0(cs.sec_member());
+        f0_.assign(f0.get_data(), f0.get_data() + f0.get_size(0));
+
+        if (engine_->step(prec, conv)) {
+            conv_prev_ = -1;
+            return true;
+        }
+        if (conv_prev_ > 0 && conv > opts_.refresh_rate * conv_prev_)
+            refresh_ = true;
+        conv_prev_ = conv;
+        if (engine_->last_krylov() == ::Jfnk::Krylov::MaxIter)
+            refresh_ = true;
+        if (engine_->last_krylov() == ::Jfnk::Krylov::Breakdown)
+            return full_step(prec, conv, "GMRES breakdown");
+        return false;
+    }
+
+    bool full_step(double prec, double& conv, const char* why) {
+        refresh_ = true;
+        conv_prev_ = -1;
+        if (rank_ == 0)
+            std::cout << "JFNK: " << why << ", taking a full Newton step" << std::endl;
+        return fine_.system().do_newton(prec, conv);
+    }
+
+    // r 为 5 个方程场之后接 5 个未知场（边界条件 X=0 的残差）
+    void precondition(const std::vector<double>& v, const std::vector<Kadath::Scalar>& r, ::Jfnk::Delta& z) {
+        Kadath::System_of_eqs& cs = coarse_->system();
+        size_t nf = coarse_fields_.size();
+        std::vector<Kadath::Scalar> src, bc;
+        for (size_t i = 0; i < nf; i++) {
+            src.push_back(Regrid::transfer(r[i], *coarse_fields_[i]));
+            bc.push_back(Regrid::transfer(r[nf + i], *coarse_fields_[i]));
+        }
+        coarse_->set_sources(src, bc);
+        cs.vars_to_terms();
+        Kadath::Array<double> fs(cs.sec_member());
+        coarse_->clear_sources();
+
+        int n = int(f0_.size());
+        std::vector<double> xx(n);
+        int ok = 1;
+        if (rank_ == 0) {
+            for (int i = 0; i < n; i++)
+                xx[i] = f0_[i] - fs(i);
+            for (int i = 0; i < fine_.nbr_point_constraints(); i++)
+                xx[i] = v[i];
+            ok = jac_.solve(xx) ? 1 : 0;
+        }
+        MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (!ok) {
+            // 分解不可用：零方向使 GMRES 中断，本步回退到完整 Newton 步
+            z.fields.clear();
+            z.values.clear();
+            for (size_t i = 0; i < nf; i++) {
+                Kadath::Scalar zero(*fine_.fields()[i]);
+                zero.annule_hard();
+                z.fields.push_back(zero);
+            }
+            if (fine_.omega_unknown())
+                z.values.push_back(0.0);
+            return;
+        }
+        MPI_Bcast(xx.data(), n, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+        // newton_update_vars 执行 x <- x - xx，差值即修正量的场表示
+        std::vector<Kadath::Scalar> saved;
+        for (const std::unique_ptr<Kadath::Scalar>& f : coarse_fields_)
+            saved.push_back(*f);
+        double omega_saved = omega_c_;
+        Kadath::Array<double> update(n);
+        for (int i = 0; i < n; i++)
+            update.set(i) = xx[i];
+        cs.newton_update_vars(update);
+
+        std::vector<Kadath::Scalar*> fine_fields = fine_.fields();
+        z.fields.clear();
+        z.values.clear();
+        for (size_t i = 0; i < coarse_fields_.size(); i++) {
+            Kadath::Scalar dc(saved[i] - *coarse_fields_[i]);
+            z.fields.push_back(Regrid::transfer(dc, *fine_fields[i]));
+            *coarse_fields_[i] = saved[i];
+        }
+        if (fine_.omega_unknown()) {
+            z.values.push_back(omega_saved - omega_c_);
+            omega_c_ = omega_saved;
+        }
+    }
+
+    Session& fine_;
+    ::Jfnk::Options opts_;
+    int rank_ = 0;
+    std::unique_ptr<Kadath::Space_polar> coarse_space_;
+    std::vector<std::unique_ptr<Kadath::Scalar>> coarse_fields_;
+    double omega_c_ = 0;
+    std::unique_ptr<Session> coarse_;
+    Chord::Jacobian jac_;
+    int nfact_ = 0;
+    bool refresh_ = true;
+    double conv_prev_ = -1;
+    std::vector<double> f0_;
+    std::unique_ptr<::Jfnk::Engine> engine_;
+};
+
+} // namespace Axi
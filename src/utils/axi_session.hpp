@@ -0,0 +1,412 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include "utils/chord_newton.hpp"
+#include "utils/newton_driver.hpp"
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Axi {
+
+inline Kadath::Scalar make_rsint(const Kadath::Space_polar& space) {
+    int ndom = space.get_nbr_domains();
+    Kadath::Scalar one(space);
+    one = 1;
+    one.std_base();
+    Kadath::Scalar rsint(space);
+    for (int d = 0; d < ndom - 1; d++)
+        rsint.set_domain(d) = space.get_domain(d)->mult_r(space.get_domain(d)->mult_sin_theta(one(d)));
+    rsint.set_domain(ndom - 1) = space.get_domain(ndom - 1)->mult_sin_theta(one(ndom - 1));
+    return rsint;
+}
+
+enum class Model { Reduced, Full };
+
+// 五场（nu, incA, incB, incbt, phi）旋转玻色星系统的持久求解会话。
+// 方程只在 build() 中解析一次；ome / lambda 及 add_parameter 注册的参数以调用方变量的
+// 引用保存，每次 newton() 前同步到常量场（System_of_eqs 只保存常量张量的指针），
+// 因此扫描中直接修改这些变量即可，无需重建系统。
+class Session {
+public:
+    Session(const Kadath::Space_polar& space,
+            int kk,
+            Kadath::Scalar& nu,
+            Kadath::Scalar& incA,
+            Kadath::Scalar& incB,
+            Kadath::Scalar& incbt,
+            Kadath::Scalar& phi,
+            double& omega,
+            double& lambda,
+            bool omega_unknown = false)
+        : space_(space), kk_(kk), qpi_(4 * M_PI), rsint_(make_rsint(space)),
+          nu_(nu), incA_(incA), incB_(incB), incbt_(incbt), phi_(phi),
+          omega_(omega), lambda_(lambda), omega_unknown_(omega_unknown) {
+        if (!omega_unknown_)
+            add_parameter("ome", omega);
+        add_parameter("lambda", lambda);
+    }
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    void add_parameter(const char* name, const double& value) {
+        if (syst_)
+            throw std::runtime_error("Session::add_parameter after build");
+        Param p;
+        p.name = name;
+        p.src = &value;
+        p.stored = 0;
+        p.valid = false;
+        p.field.reset(new Kadath::Scalar(space_));
+        params_.push_back(std::move(p));
+        store(params_.back());
+    }
+
+    void add_point_constraint(const Kadath::Point& point, const char* eq) {
+        if (syst_)
+            throw std::runtime_error("Session::add_point_constraint after build");
+        points_.push_back(point);
+        point_eqs_.push_back(eq);
+    }
+
+    // Reduced: 只解 nu / phi（及 ome）的简化系统；Full: 五场系统
+    void set_model(Model model) {
+        if (syst_)
+            throw std::runtime_error("Session::set_model after build");
+        model_ = model;
+    }
+
+    // Full 模型中把某个场冻结为常量（保持当前值），同时去掉其方程与边界条件
+    void freeze(const std::string& field) {
+        if (syst_)
+            throw std::runtime_error("Session::freeze after build");
+        for (int i = 0; i < 5; i++)
+            if (field == field_names()[i]) {
+                frozen_[i] = true;
+                return;
+            }
+        throw std::runtime_error("Session::freeze: unknown field " + field);
+    }
+
+    Model model() const { return model_; }
+    bool has_frozen() const {
+        for (bool f : frozen_)
+            if (f)
+                return true;
+        return false;
+    }
+
+    // 方程改为 eqX - srcX = 0、外边界条件改为 X - bsrcX = 0，源项为常量场（set_sources 设置，默认为零）；
+    // 供 JFNK 预条件子把残差的场表示映射为残差向量
+    void use_sources() {
+        if (syst_)
+            throw std::runtime_error("Session::use_sources after build");
+        Kadath::Scalar* f[5] = {&nu_, &incA_, &incB_, &incbt_, &phi_};
+        for (int i = 0; i < 5; i++) {
+            sources_.emplace_back(new Kadath::Scalar(*f[i]));
+            sources_.back()->annule_hard();
+            bc_sources_.emplace_back(new Kadath::Scalar(*f[i]));
+            bc_sources_.back()->annule_hard();
+        }
+    }
+
+    // 顺序同 fields()；bc 为空时边界条件的源项置零
+    void set_sources(const std::vector<Kadath::Scalar>& src, const std::vector<Kadath::Scalar>& bc = {}) {
+        for (size_t i = 0; i < sources_.size(); i++)
+            *sources_[i] = src[i];
+        for (size_t i = 0; i < bc_sources_.size(); i++) {
+            if (i < bc.size())
+                *bc_sources_[i] = bc[i];
+            else
+                bc_sources_[i]->annule_hard();
+        }
+    }
+
+    void clear_sources() {
+        for (std::unique_ptr<Kadath::Scalar>& s : sources_)
+            s->annule_hard();
+        for (std::unique_ptr<Kadath::Scalar>& s : bc_sources_)
+            s->annule_hard();
+    }
+
+    // 点约束的个数；其方程在残差向量的最前面（build 中先于场方程加入）
+    int nbr_point_constraints() const { return int(points_.size()); }
+
+    // 未知场及其对应方程定义名（add_eq 的配对）
+    std::vector<Kadath::Scalar*> fields() { return {&nu_, &incA_, &incB_, &incbt_, &phi_}; }
+    static std::vector<std::string> eq_names() { return {"eqnu", "eqA", "eqB", "eqshift", "eqphi"}; }
+    bool omega_unknown() const { return omega_unknown_; }
+    double& omega() { return omega_; }
+
+    // 在另一空间上构造同一系统：参数与点约束绑定到相同的调用方变量
+    std::unique_ptr<Session> mirror(const Kadath::Space_polar& space,
+                                    Kadath::Scalar& nu,
+                                    Kadath::Scalar& incA,
+                                    Kadath::Scalar& incB,
+                                    Kadath::Scalar& incbt,
+                                    Kadath::Scalar& phi,
+                                    double& omega) const {
+        std::unique_ptr<Session> m(new Session(space, kk_, nu, incA, incB, incbt, phi, omega, lambda_, omega_unknown_));
+        m->model_ = model_;
+        for (int i = 0; i < 5; i++)
+            m->frozen_[i] = frozen_[i];
+        for (const Param& p : params_)
+            if (p.name != "ome" && p.name != "lambda")
+                m->add_parameter(p.name.c_str(), *p.src);
+        for (size_t i = 0; i < points_.size(); i++)
+            m->add_point_constraint(points_[i], point_eqs_[i].c_str());
+        return m;
+    }
+
+    void build() {
+        if (syst_)
+            return;
+        int ndom = space_.get_nbr_domains();
+        syst_.reset(new Kadath::System_of_eqs(space_, 0, ndom - 1));
+        Kadath::System_of_eqs& syst = *syst_;
+
+        // 下标对应 fields() 的顺序
+        const int var_order[5] = {2, 0, 1, 4, 3};
+        const int eq_order[5] = {2, 1, 4, 0, 3};
+        Kadath::Scalar* f[5] = {&nu_, &incA_, &incB_, &incbt_, &phi_};
+        for (int i : var_order) {
+            if (active(i))
+                syst.add_var(field_names()[i], *f[i]);
+            else if (model_ == Model::Full)
+                syst.add_cst(field_names()[i], *f[i]);
+        }
+        if (omega_unknown_)
+            syst.add_var("ome", omega_);
+
+        syst.add_cst("rsint", rsint_);
+        syst.add_cst("k", kk_);
+        syst.add_cst("qpi", qpi_);
+        for (Param& p : params_)
+            syst.add_cst(p.name.c_str(), *p.field);
+        for (size_t i = 0; i < sources_.size(); i++)
+            syst.add_cst(source_names()[i], *sources_[i]);
+        for (size_t i = 0; i < bc_sources_.size(); i++)
+            syst.add_cst(bc_source_names()[i], *bc_sources_[i]);
+
+        if (model_ == Model::Reduced)
+            define_reduced(syst, ndom);
+        else
+            define_full(syst, ndom);
+
+        for (size_t i = 0; i < points_.size(); i++)
+            space_.add_eq_point(syst, points_[i], point_eqs_[i].c_str());
+
+        for (int i : eq_order) {
+            if (!active(i))
+                continue;
+            std::string eq = std::string(eq_def_names()[i]) + (sources_.empty() ? "" : std::string("-") + source_names()[i]) + "=0";
+            std::string dn = std::string("dn(") + field_names()[i] + ")";
+            space_.add_eq(syst, eq.c_str(), field_names()[i], dn.c_str());
+        }
+
+        for (int i = 0; i < 5; i++) {
+            if (!active(i))
+                continue;
+            std::string bc = std::string(field_names()[i]) + (bc_sources_.empty() ? "" : std::string("-") + bc_source_names()[i]) + "=0";
+            syst.add_eq_bc(ndom - 1, OUTER_BC, bc.c_str());
+        }
+    }
+
+    // 改用弦方法 / Broyden 引擎（见 chord_newton.hpp），分解的 Jacobian 在求解之间保留
+    void use_chord(Chord::Options opts = Chord::Options()) {
+        chord_opts_ = opts;
+        use_chord_ = true;
+    }
+
+    // 构建系统并把参数同步到常量场
+    void sync() {
+        build();
+        for (Param& p : params_)
+            store(p);
+    }
+
+    // 由外部引擎执行 Newton 步（如 JFNK，见 axi_jfnk.hpp）；参数仍在每步前同步
+    void use_stepper(std::function<bool(double, double&)> stepper) { stepper_ = stepper; }
+
+    // 每个参数点开始时调用
+    void begin_solve() {
+        if (chord_)
+            chord_->begin();
+    }
+
+    // 求解失败后调用，下一步重新装配 Jacobian
+    void invalidate_jacobian() {
+        if (chord_)
+            chord_->invalidate();
+    }
+
+    int nbr_factorizations() const { return chord_ ? chord_->nbr_factorizations() : 0; }
+
+    // 单步 Newton；参数在每步前同步
+    template <Kadath::Computational_model model = Kadath::default_computational_model>
+    bool newton(double prec, double& conv) {
+        sync();
+        if (stepper_)
+            return stepper_(prec, conv);
+        if (use_chord_) {
+            if (!chord_)
+                chord_.reset(new Chord::Engine(*syst_, chord_opts_));
+            return chord_->step(prec, conv);
+        }
+        return syst_->template do_newton<model>(prec, conv);
+    }
+
+    // 带线搜索的阻尼 Newton 步（常规步失败后的回退）
+    bool newton_linesearch(double prec, double& conv, int ntry, double stepmax) {
+        sync();
+        if (chord_)
+            chord_->invalidate();
+        return syst_->do_newton_with_linesearch(prec, conv, ntry, stepmax);
+    }
+
+    // 受监控的完整求解（见 newton_driver.hpp）；失败时未知量停在最后一次迭代
+    Newton::Report solve(const Newton::Options& opts, const Newton::Monitor& monitor = Newton::Monitor()) {
+        std::vector<double*> values;
+        if (omega_unknown_)
+            values.push_back(&omega_);
+        Newton::Snapshot snap({&nu_, &incA_, &incB_, &incbt_, &phi_}, values);
+        return Newton::run(opts,
+                           [&](double prec, double& conv) { return newton(prec, conv); },
+                           [&](double prec, double& conv, int ntry, double stepmax) {
+                               return newton_linesearch(prec, conv, ntry, stepmax);
+                           },
+                           &snap, monitor);
+    }
+
+    Kadath::System_of_eqs& system() {
+        build();
+        return *syst_;
+    }
+
+    const Kadath::Space_polar& space() const { return space_; }
+    const Kadath::Scalar& rsint() const { return rsint_; }
+    int kk() const { return kk_; }
+
+private:
+    // 五场系统（incB/incA/incbt 冻结时仍按常量参与定义）
+    void define_full(Kadath::System_of_eqs& syst, int ndom) {
+        syst.add_def("phisurrsint = divrsint(phi)");
+        syst.add_def("ap = exp(nu)");
+        syst.add_def("bt = divrsint(incbt)");
+        syst.add_def("B = (divrsint(incB) + 1)/ap");
+        syst.add_def("A = exp(incA - nu)");
+
+        syst.add_def("E = 0.5*(ome-bt*k)^2/ap^2*phi^2 + 0.5*scal(grad(phi),grad(phi))/A^2 + 0.5*phi^2 + 0.25*lambda*phi^4 + 0.5*k*k*phisurrsint*phisurrsint/B^2");
+        syst.add_def("Pp = k/ap* (ome-bt*k)*phi^2");
+        syst.add_def("S = -0.5*scal(grad(phi), grad(phi))/A^2 - 0.5*k*k*phisurrsint*phisurrsint/B^2 + 1.5*(ome-bt*k)^2/ap^2 * phi^2- 1.5*phi^2 -0.75*lambda*phi^4");
+        syst.add_def("Spp = 0.5*(ome-bt*k)^2/ap^2*phi^2 -0.5* scal(grad(phi),grad(phi))/A^2 -0.5* phi^2 -0.25*lambda*phi^4 +0.5* k*k*phisurrsint*phisurrsint/B^2");
+
+        for (int d = 0; d < ndom - 1; d++)
+            syst.add_def(d, "eqB = lap2(incB) -2*qpi*ap*A^2*B*rsint*(S-Spp)");
+        syst.add_def(ndom - 1, "eqB = lap2(incB) -2*qpi*ap*A^2*B*rsint*multr(S-Spp)");
+
+        for (int d = 0; d < ndom - 1; d++)
+            syst.add_def(d, "eqshift = lap(incbt) - divrsint(bt) - rsint*scal(grad(bt),grad(nu-3*log(B)))+4*qpi*ap*A^2/B^2*divrsint(Pp)");
+        syst.add_def(ndom - 1, "eqshift = lap(incbt) - divrsint(bt) - rsint*scal(multr(grad(bt)),grad(nu-3*log(B)))+4*qpi*ap*A^2/B^2*divrsint(Pp)");
+
+        for (int d = 0; d < ndom - 1; d++)
+            syst.add_def(d, "eqnu = lap(nu) - B^2*rsint^2/2/ap^2 * scal(grad(bt) , grad(bt)) + scal(grad(nu), grad(nu+log(B))) - qpi*A^2*(E+S)");
+        syst.add_def(ndom - 1, "eqnu = lap(nu) - B^2*rsint^2/2/ap^2 * scal(multr(grad(bt)) , multr(grad(bt))) + scal(grad(nu), grad(nu+log(B))) - qpi*A^2*(E+S)");
+
+        for (int d = 0; d < ndom - 1; d++)
+            syst.add_def(d, "eqA = lap2(incA) - 2*qpi*A^2*Spp- 3 * B^2 * rsint^2 /4 / ap^2 * scal(grad(bt) , grad(bt)) + scal(grad(nu),grad(nu))");
+        syst.add_def(ndom - 1, "eqA =lap2(incA) - 2*qpi*A^2*Spp- 3 * B^2 * rsint^2 /4 / ap^2 * scal(multr(grad(bt)) , multr(grad(bt))) + scal(grad(nu),grad(nu)) ");
+
+        for (int d = 0; d < ndom - 1; d++)
+            syst.add_def(d, "eqphi = lap(phi) - A^2*(1 + lambda*phi^2 -ome*ome/ap^2+2*bt/ap^2*ome*k-bt^2/ap^2*k*k)*phi + scal(grad(phi),grad(nu+log(B))) - divrsint(A^2/B^2 -1)*divrsint(phi)*k*k");
+        syst.add_def(ndom - 1, "eqphi = lap(phi) - A^2*(1 + lambda*phi^2 -ome*ome/ap^2+2*bt/ap^2*ome*k-bt^2/ap^2*k*k)*phi + scal(grad(phi),grad(nu+log(B))) - k*k*divrsint(A^2/B^2-1)*divrsint(phi)");
+    }
+
+    // 度规只保留 nu 的简化系统（rbs 的第一阶段）
+    void define_reduced(Kadath::System_of_eqs& syst, int ndom) {
+        syst.add_def("phisurrsint = divrsint(phi)");
+        syst.add_def("ap = exp(nu)");
+        syst.add_def("E = 0.5* ome*ome/ap^2*phi^2 + 0.5*scal(grad(phi),grad(phi)) + 0.5*phi^2 + 0.25*lambda*phi^4 + 0.5*k*k*phisurrsint*phisurrsint");
+        syst.add_def("Pp = k/ap* ome*phi^2");
+        syst.add_def("S = -0.5*scal(grad(phi), grad(phi)) - 0.5*k*k*phisurrsint*phisurrsint + 1.5*ome*ome/ap^2 * phi^2- 1.5*phi^2 -0.75*lambda*phi^4");
+        syst.add_def("Spp = 0.5*ome*ome/ap^2*phi^2 -0.5* scal(grad(phi),grad(phi))- 0.5* phi^2 - 0.25*lambda*phi^4 + 0.5* k*k*phisurrsint*phisurrsint");
+
+        for (int d = 0; d < ndom; d++)
+            syst.add_def(d, "eqnu = lap(nu) + scal(grad(nu), grad(nu)) - qpi*(E+S)");
+        for (int d = 0; d < ndom; d++)
+            syst.add_def(d, "eqphi = lap(phi) - (1-ome*ome/ap^2)*phi + scal(grad(phi),grad(nu))- lambda*phi^3");
+    }
+
+    bool active(int i) const {
+        if (model_ == Model::Reduced)
+            return i == 0 || i == 4;
+        return !frozen_[i];
+    }
+
+    static const char* const* field_names() {
+        static const char* const names[5] = {"nu", "incA", "incB", "incbt", "phi"};
+        return names;
+    }
+
+    static const char* const* eq_def_names() {
+        static const char* const names[5] = {"eqnu", "eqA", "eqB", "eqshift", "eqphi"};
+        return names;
+    }
+
+    static const char* const* source_names() {
+        static const char* const names[5] = {"srcnu", "srcA", "srcB", "srcshift", "srcphi"};
+        return names;
+    }
+
+    static const char* const* bc_source_names() {
+        static const char* const names[5] = {"bsrcnu", "bsrcA", "bsrcB", "bsrcshift", "bsrcphi"};
+        return names;
+    }
+
+    struct Param {
+        std::string name;
+        const double* src;
+        double stored;
+        bool valid;
+        std::unique_ptr<Kadath::Scalar> field;
+    };
+
+    void store(Param& p) {
+        if (p.valid && p.stored == *p.src)
+            return;
+        p.stored = *p.src;
+        p.valid = true;
+        *p.field = p.stored;
+        p.field->std_base();
+    }
+
+    const Kadath::Space_polar& space_;
+    int kk_;
+    double qpi_;
+    Kadath::Scalar rsint_;
+    Kadath::Scalar& nu_;
+    Kadath::Scalar& incA_;
+    Kadath::Scalar& incB_;
+    Kadath::Scalar& incbt_;
+    Kadath::Scalar& phi_;
+    double& omega_;
+    double& lambda_;
+    bool omega_unknown_;
+    Model model_ = Model::Full;
+    bool frozen_[5] = {false, false, false, false, false};
+    std::vector<Param> params_;
+    std::vector<Kadath::Point> points_;
+    std::vector<std::string> point_eqs_;
+    std::vector<std::unique_ptr<Kadath::Scalar>> sources_;
+    std::vector<std::unique_ptr<Kadath::Scalar>> bc_sources_;
+    std::unique_ptr<Kadath::System_of_eqs> syst_;
+    std::function<bool(double, double&)> stepper_;
+    bool use_chord_ = false;
+    Chord::Options chord_opts_;
+    std::unique_ptr<Chord::Engine> chord_;
+};
+
+} // namespace Axi
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <glob.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace Batch_files {
+
+// 目录（其中全部 .dat）、@列表文件（每行一个路径，# 开头为注释）或 glob 模式；目录与 glob 的结果按字典序
+inline std::vector<std::string> expand(const std::string& spec) {
+    std::vector<std::string> files;
+    if (!spec.empty() && spec[0] == '@') {
+        std::ifstream in(spec.substr(1));
+        if (!in)
+            throw std::runtime_error("Cannot open file list: " + spec.substr(1));
+        std::string line;
+        while (std::getline(in, line))
+            if (!line.empty() && line[0] != '#')
+                files.push_back(line);
+        return files;
+    }
+    struct stat st;
+    if (stat(spec.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        DIR* dir = opendir(spec.c_str());
+        if (!dir)
+            throw std::runtime_error("Cannot open directory: " + spec);
+        while (struct dirent* e = readdir(dir)) {
+            std::string name = e->d_name;
+            if (name.size() > 4 && name.substr(name.size() - 4) == ".dat")
+                files.push_back(spec + "/" + name);
+        }
+        closedir(dir);
+    } else {
+        glob_t g;
+        if (glob(spec.c_str(), 0, nullptr, &g) == 0)
+            for (size_t i = 0; i < g.gl_pathc; i++)
+                files.push_back(g.gl_pathv[i]);
+        globfree(&g);
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+inline int default_jobs() { return int(std::max(1u, std::thread::hardware_concurrency())); }
+
+// 把下标 0..n-1 的任务按 i mod jobs 分给 jobs 个 fork 出的进程（Kadath 不是线程安全的，不能用线程）。
+// fn(i) 返回该任务的一行结果（不含换行），各进程写到 <scratch>.part<w> 分片，父进程按下标顺序收回；
+// 工作进程异常退出时其未写出的任务结果为空串。jobs <= 1 时在本进程内顺序执行。
+template <class Fn>
+inline std::vector<std::string> run(size_t n, int jobs, const std::string& scratch, Fn&& fn) {
+    std::vector<std::string> results(n);
+    if (jobs <= 0)
+        jobs = default_jobs();
+    jobs = int(std::min<size_t>(size_t(jobs), std::max<size_t>(n, 1)));
+    if (jobs == 1) {
+        for (size_t i = 0; i < n; i++)
+            results[i] = fn(i);
+        return results;
+    }
+
+    std::vector<std::string> parts(jobs);
+    std::vector<pid_t> pids;
+    std::cout.flush();
+    std::cerr.flush();
+    for (int w = 0; w < jobs; w++) {
+        parts[w] = scratch + ".part" + std::to_string(w);
+        pid_t pid = fork();
+        if (pid < 0)
+            throw std::runtime_error("fork failed");
+        if (pid == 0) {
+            FILE* f = fopen(parts[w].c_str(), "w");
+            if (!f)
+                _exit(1);
+            for (size_t i = w; i < n; i += jobs) {
+                std::string line = fn(i);
+                std::replace(line.begin(), line.end(), '\n', ' ');
+                fprintf(f, "%zu\t%s\n", i, line.c_str());
+                fflush(f);
+            }
+            fclose(f);
+            _exit(0);
+        }
+        pids.push_back(pid);
+    }
+    for (pid_t pid : pids) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+    }
+    for (const std::string& part : parts) {
+        std::ifstream in(part);
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t tab = line.find('\t');
+            size_t i = std::strtoul(line.c_str(), nullptr, 10);
+            if (tab != std::string::npos && i < n)
+                results[i] = line.substr(tab + 1);
+        }
+        std::remove(part.c_str());
+    }
+    return results;
+}
+
+} // namespace Batch_files
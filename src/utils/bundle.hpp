@@ -0,0 +1,292 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include "utils/io_commons.hpp"
+#include "utils/regrid.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace Bundle {
+
+// 一条扫描分支存成一个只追加的文件，空间只存一次：
+//   magic[8] "BSBUNDLE" | version:int | kind:int | Space_polar
+//   记录 × N："BREC" | kk:int | omega:double | lambda:double | base:int | encoding:int | size:u64 | 各场
+// base = -1 为完整记录，否则各场存的是与第 base 条记录（解码后）的差值。
+// 没有单独的索引块：打开时按 size 跳读记录头建立 (kk, omega, lambda) -> 偏移 的索引，
+// 写了一半的末尾记录（size 为 0 或越过文件尾）被忽略，下次追加时截掉。
+static const char MAGIC[8] = {'B', 'S', 'B', 'U', 'N', 'D', 'L', 'E'};
+static const char REC_MAGIC[4] = {'B', 'R', 'E', 'C'};
+static constexpr int VERSION = 2;   // 版本 2 起记录可为 ENC_COEF_* 编码
+
+struct Options {
+    bool delta = true;       // 相对上一条记录存差值；只在截尾时生效（完整存储的差值与场本身一样大，只多解码代价与舍入）
+    int keyframe = 16;       // 差值链的最大长度，到达后存一条完整记录（限制随机读取的解码代价）
+    double trim_tol = -1;    // >= 0 时谱系数截尾（见 Io::detail::write_trimmed；差值记录的阈值相对解本身）
+    bool native = false;     // 不截尾时按本机字节序整块存谱系数（见 Io::detail::write_coefs）
+};
+
+struct Entry {
+    int id = 0;
+    int kk = 0;
+    double omega = 0;
+    double lambda = 0;
+    int base = -1;
+    int depth = 0;           // 差值链长度，完整记录为 0
+    int encoding = Io::ENC_RAW;
+    long offset = 0;         // 各场数据的起始偏移
+    std::uint64_t size = 0;
+};
+
+// 记录引用 "<bundle>#<id>"（如扫描清单中的 path 列）
+inline bool split_ref(const std::string& ref, std::string& file, int& id) {
+    size_t pos = ref.rfind('#');
+    if (pos == std::string::npos || pos + 1 >= ref.size())
+        return false;
+    for (size_t i = pos + 1; i < ref.size(); i++)
+        if (ref[i] < '0' || ref[i] > '9')
+            return false;
+    file = ref.substr(0, pos);
+    id = std::stoi(ref.substr(pos + 1));
+    return true;
+}
+
+inline std::string make_ref(const std::string& file, int id) { return file + "#" + std::to_string(id); }
+
+class Archive {
+public:
+    using Fields = std::vector<std::unique_ptr<Kadath::Scalar>>;
+
+    // 新建（已存在时覆盖）：写文件头与空间
+    static void create(const std::string& path, const Kadath::Space_polar& space, Io::SolutionKind kind) {
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f)
+            throw std::runtime_error("Bundle: cannot create " + path);
+        fwrite(MAGIC, 1, sizeof(MAGIC), f);
+        int version = VERSION;
+        int kind_tag = kind == Io::SolutionKind::Axisymmetric ? 0 : 1;
+        Kadath::fwrite_be(&version, sizeof(int), 1, f);
+        Kadath::fwrite_be(&kind_tag, sizeof(int), 1, f);
+        space.save(f);
+        fflush(f);
+        fsync(fileno(f));
+        fclose(f);
+    }
+
+    // 打开已有 bundle 并建立索引；onto 非空时场构造在调用方的同一网格上（不再持有文件中的空间），
+    // 此时 onto 须与文件中的网格一致（Regrid::grid_key 相同），否则抛出
+    explicit Archive(const std::string& path, const Kadath::Space_polar* onto = nullptr, bool writable = false)
+        : path_(path) {
+        f_ = fopen(path.c_str(), writable ? "r+b" : "rb");
+        if (!f_)
+            throw std::runtime_error("Bundle: cannot open " + path);
+        char magic[sizeof(MAGIC)];
+        int version = 0;
+        int kind_tag = 0;
+        if (fread(magic, 1, sizeof(magic), f_) != sizeof(magic) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0
+            || Kadath::fread_be(&version, sizeof(int), 1, f_) != 1 || Kadath::fread_be(&kind_tag, sizeof(int), 1, f_) != 1) {
+            fclose(f_);
+            throw std::runtime_error("Bundle: not a bundle file: " + path);
+        }
+        if (version > VERSION) {
+            fclose(f_);
+            throw std::runtime_error("Bundle: unsupported version in " + path);
+        }
+        kind_ = kind_tag == 0 ? Io::SolutionKind::Axisymmetric : Io::SolutionKind::Spherical;
+        own_space_.reset(new Kadath::Space_polar(f_));
+        long first_record = ftell(f_);
+        if (onto) {
+            if (Regrid::grid_key(*onto) != Regrid::grid_key(*own_space_)) {
+                std::string msg = "Bundle: " + path + " holds grid " + Regrid::grid_key(*own_space_)
+                    + ", not " + Regrid::grid_key(*onto);
+                fclose(f_);
+                throw std::runtime_error(msg);
+            }
+            own_space_.reset();
+            space_ = onto;
+        } else {
+            space_ = own_space_.get();
+        }
+        scan(first_record);
+    }
+
+    ~Archive() {
+        if (f_)
+            fclose(f_);
+    }
+
+    Archive(const Archive&) = delete;
+    Archive& operator=(const Archive&) = delete;
+
+    const std::string& path() const { return path_; }
+    const Kadath::Space_polar& space() const { return *space_; }
+    Io::SolutionKind kind() const { return kind_; }
+    const std::vector<Entry>& entries() const { return entries_; }
+    int size() const { return int(entries_.size()); }
+
+    // 参数相同（在 tol 内）的最后一条记录，没有则返回 -1
+    int find(int kk, double omega, double lambda, double tol = 1e-12) const {
+        for (int i = int(entries_.size()) - 1; i >= 0; i--) {
+            const Entry& e = entries_[i];
+            if (e.kk == kk && std::fabs(e.omega - omega) <= tol && std::fabs(e.lambda - lambda) <= tol)
+                return i;
+        }
+        return -1;
+    }
+
+    // 解码第 id 条记录（顺序 field_names(kind)）；最近一次解码的结果被缓存，顺序遍历时每条只读一次
+    const Fields& load(int id) {
+        if (id < 0 || id >= int(entries_.size()))
+            throw std::runtime_error("Bundle: no record " + std::to_string(id) + " in " + path_);
+        if (id == cache_id_)
+            return cache_;
+        const Entry& e = entries_[id];
+        Fields base;
+        if (e.base >= 0) {
+            const Fields& b = load(e.base);
+            for (const std::unique_ptr<Kadath::Scalar>& s : b)
+                base.emplace_back(new Kadath::Scalar(*s));
+        }
+        fseek(f_, e.offset, SEEK_SET);
+        Fields out;
+        for (size_t i = 0; i < Io::field_names(kind_).size(); i++) {
+            std::unique_ptr<Kadath::Scalar> s;
+            if (e.encoding == Io::ENC_TRIMMED)
+                s.reset(Io::detail::read_trimmed(*space_, f_, path_.c_str()));
+            else if (e.encoding == Io::ENC_COEF_LE || e.encoding == Io::ENC_COEF_BE)
+                s.reset(Io::detail::read_coefs(*space_, f_, path_.c_str(), e.encoding == Io::ENC_COEF_LE));
+            else
+                s.reset(new Kadath::Scalar(*space_, f_));
+            if (e.base >= 0)
+                s.reset(new Kadath::Scalar(*base[i] + *s));
+            out.push_back(std::move(s));
+        }
+        if (kind_ == Io::SolutionKind::Axisymmetric) {
+            Kadath::Param_tensor parameters;
+            parameters.set_m_quant() = e.kk;
+            out.back()->set_parameters() = parameters;
+        }
+        cache_ = std::move(out);
+        cache_id_ = id;
+        return cache_;
+    }
+
+    // 追加一条记录（只应由一个进程调用），返回其编号；fields 须位于 space() 上
+    int append(int kk, double omega, double lambda, const std::vector<const Kadath::Scalar*>& fields,
+               const Options& opts = Options()) {
+        if (fields.size() != Io::field_names(kind_).size())
+            throw std::runtime_error("Bundle: wrong number of fields for " + path_);
+        int id = int(entries_.size());
+        int base = -1;
+        if (opts.delta && opts.trim_tol >= 0 && id > 0 && entries_.back().depth + 1 < opts.keyframe)
+            base = id - 1;
+        int encoding = opts.trim_tol >= 0 ? Io::ENC_TRIMMED
+            : (opts.native ? (Io::detail::host_little_endian() ? Io::ENC_COEF_LE : Io::ENC_COEF_BE) : Io::ENC_RAW);
+        bool coefs = encoding == Io::ENC_COEF_LE || encoding == Io::ENC_COEF_BE;
+        // 差值相对解码后的前一条记录，截尾误差不会沿链累积；先解码，之后不再移动文件位置
+        const Fields* pred = base >= 0 ? &load(base) : nullptr;
+
+        // 截掉可能存在的不完整末尾记录
+        if (ftruncate(fileno(f_), good_end_) != 0)
+            throw std::runtime_error("Bundle: cannot truncate " + path_);
+        fseek(f_, good_end_, SEEK_SET);
+        fwrite(REC_MAGIC, 1, sizeof(REC_MAGIC), f_);
+        Kadath::fwrite_be(&kk, sizeof(int), 1, f_);
+        Kadath::fwrite_be(&omega, sizeof(double), 1, f_);
+        Kadath::fwrite_be(&lambda, sizeof(double), 1, f_);
+        Kadath::fwrite_be(&base, sizeof(int), 1, f_);
+        Kadath::fwrite_be(&encoding, sizeof(int), 1, f_);
+        long size_pos = ftell(f_);
+        Io::detail::write_u64(0, f_);
+        long offset = ftell(f_);
+
+        for (size_t i = 0; i < fields.size(); i++) {
+            if (pred) {
+                Kadath::Scalar diff(*fields[i] - *(*pred)[i]);
+                if (encoding == Io::ENC_TRIMMED)
+                    Io::detail::write_trimmed(diff, opts.trim_tol, f_, fields[i]);
+                else if (coefs)
+                    Io::detail::write_coefs(diff, f_);
+                else
+                    diff.save(f_);
+            } else if (encoding == Io::ENC_TRIMMED) {
+                Io::detail::write_trimmed(*fields[i], opts.trim_tol, f_);
+            } else if (coefs) {
+                Io::detail::write_coefs(*fields[i], f_);
+            } else {
+                fields[i]->save(f_);
+            }
+        }
+        long end = ftell(f_);
+        fflush(f_);
+        fsync(fileno(f_));
+        fseek(f_, size_pos, SEEK_SET);
+        Io::detail::write_u64(std::uint64_t(end - offset), f_);
+        fflush(f_);
+        fsync(fileno(f_));
+
+        Entry e;
+        e.id = id;
+        e.kk = kk;
+        e.omega = omega;
+        e.lambda = lambda;
+        e.base = base;
+        e.depth = base >= 0 ? entries_[base].depth + 1 : 0;
+        e.encoding = encoding;
+        e.offset = offset;
+        e.size = std::uint64_t(end - offset);
+        entries_.push_back(e);
+        good_end_ = end;
+        return id;
+    }
+
+private:
+    void scan(long first_record) {
+        fseek(f_, 0, SEEK_END);
+        long file_end = ftell(f_);
+        fseek(f_, first_record, SEEK_SET);
+        good_end_ = first_record;
+        while (true) {
+            char magic[sizeof(REC_MAGIC)];
+            Entry e;
+            e.id = int(entries_.size());
+            std::uint64_t size = 0;
+            bool ok = fread(magic, 1, sizeof(magic), f_) == sizeof(magic)
+                && std::memcmp(magic, REC_MAGIC, sizeof(REC_MAGIC)) == 0
+                && Kadath::fread_be(&e.kk, sizeof(int), 1, f_) == 1
+                && Kadath::fread_be(&e.omega, sizeof(double), 1, f_) == 1
+                && Kadath::fread_be(&e.lambda, sizeof(double), 1, f_) == 1
+                && Kadath::fread_be(&e.base, sizeof(int), 1, f_) == 1
+                && Kadath::fread_be(&e.encoding, sizeof(int), 1, f_) == 1
+                && Io::detail::read_u64(size, f_);
+            if (!ok || size == 0)
+                break;
+            e.offset = ftell(f_);
+            e.size = size;
+            if (e.offset + long(size) > file_end || e.base >= e.id)
+                break;
+            e.depth = e.base >= 0 ? entries_[e.base].depth + 1 : 0;
+            entries_.push_back(e);
+            good_end_ = e.offset + long(size);
+            fseek(f_, good_end_, SEEK_SET);
+        }
+    }
+
+    std::string path_;
+    FILE* f_ = nullptr;
+    Io::SolutionKind kind_ = Io::SolutionKind::Axisymmetric;
+    std::unique_ptr<Kadath::Space_polar> own_space_;
+    const Kadath::Space_polar* space_ = nullptr;
+    std::vector<Entry> entries_;
+    long good_end_ = 0;
+    int cache_id_ = -1;
+    Fields cache_;
+};
+
+} // namespace Bundle
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include "mpi.h"
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace Checkpoint {
+
+// 求解进度：阶段、延拓步、当前 Newton 求解的残差历史（续算时继续计入迭代上限与停滞判据）
+struct Progress {
+    int stage = 0;
+    int ramp_step = 0;
+    double ramp_from = 0;
+    int linesearch_from = -1;    // 已进入线搜索阶段时，该阶段在 history 中的起始下标
+    std::vector<double> history;
+};
+
+// 版本 02 起文件尾为 END_MAGIC | 主体长度:u64 | 主体的 FNV-1a:u64（主体为尾部之前的全部字节），
+// 读取前先校验，截断或损坏的检查点（Kadath 的 Scalar 读取不检查返回值）在解析之前即被拒绝
+static const char MAGIC[8] = {'B', 'S', 'C', 'K', 'P', 'T', '0', '2'};
+static const char MAGIC_V1[8] = {'B', 'S', 'C', 'K', 'P', 'T', '0', '1'};
+static const char END_MAGIC[8] = {'B', 'S', 'C', 'K', 'E', 'N', 'D', '!'};
+
+namespace detail {
+
+inline std::uint64_t fnv1a(const char* data, size_t n) {
+    std::uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < n; i++) {
+        h ^= std::uint64_t(static_cast<unsigned char>(data[i]));
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+inline void put_u64(std::string& out, std::uint64_t v) {
+    for (int i = 7; i >= 0; i--)
+        out.push_back(char((v >> (8 * i)) & 0xff));
+}
+
+inline std::uint64_t get_u64(const char* p) {
+    std::uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v = (v << 8) | static_cast<unsigned char>(p[i]);
+    return v;
+}
+
+// 版本 02 的文件尾校验；返回主体长度，不合格时返回 -1
+inline long check_trailer(FILE* f) {
+    if (fseek(f, 0, SEEK_END) != 0)
+        return -1;
+    long size = ftell(f);
+    const long tail = long(sizeof(END_MAGIC)) + 16;
+    if (size < long(sizeof(MAGIC)) + tail)
+        return -1;
+    std::string body(size_t(size - tail), '\0');
+    char trailer[sizeof(END_MAGIC) + 16];
+    rewind(f);
+    if (fread(&body[0], 1, body.size(), f) != body.size() || fread(trailer, 1, sizeof(trailer), f) != sizeof(trailer))
+        return -1;
+    if (std::memcmp(trailer, END_MAGIC, sizeof(END_MAGIC)) != 0
+        || get_u64(trailer + sizeof(END_MAGIC)) != std::uint64_t(body.size())
+        || get_u64(trailer + sizeof(END_MAGIC) + 8) != fnv1a(body.data(), body.size()))
+        return -1;
+    return long(body.size());
+}
+
+} // namespace detail
+
+inline volatile std::sig_atomic_t& stop_flag() {
+    static volatile std::sig_atomic_t flag = 0;
+    return flag;
+}
+
+inline void on_sigterm(int) { stop_flag() = 1; }
+
+inline void install_sigterm_handler() {
+    stop_flag() = 0;
+    std::signal(SIGTERM, on_sigterm);
+}
+
+// 集体调用：任一 rank 收到 SIGTERM 即全体停止，避免各 rank 在不同迭代退出
+inline bool stop_requested() {
+    int local = stop_flag() ? 1 : 0;
+    int global = 0;
+    MPI_Allreduce(&local, &global, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    return global != 0;
+}
+
+// 命令行中的 --resume <file>，没有则返回空串
+inline std::string resume_path(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i++)
+        if (std::strcmp(argv[i], "--resume") == 0)
+            return argv[i + 1];
+    return "";
+}
+
+// 双缓冲写出：先写 path.tmp 并 fsync，再把旧的 path 改名为 path.prev，最后把 tmp 原子改名为 path。
+// 任意时刻被杀死，path 或 path.prev 中至少有一个是完整的检查点。只有 rank 0 写文件。
+// 写 tmp 的任一步（fwrite / fflush / fsync / fclose）失败时删除 tmp、不动 path 与 path.prev，
+// 打印原因并返回 false（不抛出：只有 rank 0 写，抛出会使其余 rank 卡在集体求解中）。
+class Writer {
+public:
+    Writer(const std::string& path, int rank) : path_(path), rank_(rank) {}
+
+    const std::string& path() const { return path_; }
+
+    bool write(const Progress& prog, const std::function<void(FILE*)>& payload) const {
+        if (rank_ != 0 || path_.empty())
+            return true;
+        std::string tmp = path_ + ".tmp";
+        try {
+            write_tmp(tmp, prog, payload);
+        } catch (const std::exception& e) {
+            unlink(tmp.c_str());
+            std::cerr << "Checkpoint: " << e.what() << ", keeping the previous checkpoint" << std::endl;
+            return false;
+        }
+
+        std::string prev = path_ + ".prev";
+        if (access(path_.c_str(), F_OK) == 0 && std::rename(path_.c_str(), prev.c_str()) != 0) {
+            unlink(tmp.c_str());
+            std::cerr << "Checkpoint: cannot rotate " << path_ << std::endl;
+            return false;
+        }
+        if (std::rename(tmp.c_str(), path_.c_str()) != 0) {
+            std::cerr << "Checkpoint: cannot rename " << tmp << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // 主体先序列化到内存（求校验和），再连同文件尾一次写出
+    static void write_tmp(const std::string& tmp, const Progress& prog, const std::function<void(FILE*)>& payload) {
+        char* buf = nullptr;
+        size_t size = 0;
+        FILE* m = open_memstream(&buf, &size);
+        if (!m)
+            throw std::runtime_error("cannot open memory stream");
+        fwrite(MAGIC, 1, sizeof(MAGIC), m);
+        int stage = prog.stage;
+        int ramp_step = prog.ramp_step;
+        int ls_from = prog.linesearch_from;
+        int nhist = int(prog.history.size());
+        double ramp_from = prog.ramp_from;
+        fwrite_be(&stage, sizeof(int), 1, m);
+        fwrite_be(&ramp_step, sizeof(int), 1, m);
+        fwrite_be(&ls_from, sizeof(int), 1, m);
+        fwrite_be(&ramp_from, sizeof(double), 1, m);
+        fwrite_be(&nhist, sizeof(int), 1, m);
+        for (double h : prog.history)
+            fwrite_be(&h, sizeof(double), 1, m);
+        try {
+            payload(m);
+        } catch (...) {
+            fclose(m);
+            free(buf);
+            throw;
+        }
+        bool ok = !ferror(m);
+        ok = fclose(m) == 0 && ok;
+        std::string bytes(buf ? buf : "", ok ? size : 0);
+        free(buf);
+        if (!ok)
+            throw std::runtime_error("cannot serialize the checkpoint");
+        std::string trailer(END_MAGIC, sizeof(END_MAGIC));
+        detail::put_u64(trailer, bytes.size());
+        detail::put_u64(trailer, detail::fnv1a(bytes.data(), bytes.size()));
+
+        FILE* f = fopen(tmp.c_str(), "wb");
+        if (!f)
+            throw std::runtime_error("cannot open " + tmp);
+        ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size()
+            && fwrite(trailer.data(), 1, trailer.size(), f) == trailer.size()
+            && fflush(f) == 0 && fsync(fileno(f)) == 0;
+        ok = fclose(f) == 0 && ok;
+        if (!ok)
+            throw std::runtime_error("cannot write " + tmp);
+    }
+
+    std::string path_;
+    int rank_;
+};
+
+// 读取 path（不存在、校验失败或不完整时退回 path.prev）；payload 在头部之后读取状态，
+// 读到不完整的数据时抛 std::runtime_error。版本 01 的旧检查点没有文件尾，只能按读取返回值判断
+inline bool read(const std::string& path, Progress& prog, const std::function<void(FILE*)>& payload) {
+    for (const std::string& p : {path, path + ".prev"}) {
+        FILE* f = fopen(p.c_str(), "rb");
+        if (!f)
+            continue;
+        char magic[sizeof(MAGIC)];
+        int nhist = 0;
+        bool ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic);
+        bool v1 = ok && std::memcmp(magic, MAGIC_V1, sizeof(MAGIC_V1)) == 0;
+        ok = ok && (v1 || std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0);
+        long body = -1;
+        if (ok && !v1) {
+            body = detail::check_trailer(f);
+            ok = body >= 0 && fseek(f, long(sizeof(MAGIC)), SEEK_SET) == 0;
+            if (!ok)
+                std::cerr << "Checkpoint: " << p << " is truncated or corrupt" << std::endl;
+        }
+        ok = ok
+            && fread_be(&prog.stage, sizeof(int), 1, f) == 1
+            && fread_be(&prog.ramp_step, sizeof(int), 1, f) == 1
+            && fread_be(&prog.linesearch_from, sizeof(int), 1, f) == 1
+            && fread_be(&prog.ramp_from, sizeof(double), 1, f) == 1
+            && fread_be(&nhist, sizeof(int), 1, f) == 1 && nhist >= 0;
+        if (ok) {
+            prog.history.resize(nhist);
+            for (int i = 0; i < nhist && ok; i++)
+                ok = fread_be(&prog.history[i], sizeof(double), 1, f) == 1;
+        }
+        if (ok) {
+            try {
+                payload(f);
+            } catch (const std::runtime_error& e) {
+                std::cerr << "Checkpoint: " << p << ": " << e.what() << std::endl;
+                ok = false;
+            }
+            // 主体须恰好读完
+            if (ok && body >= 0 && ftell(f) != body) {
+                std::cerr << "Checkpoint: " << p << " does not match its payload" << std::endl;
+                ok = false;
+            }
+        }
+        fclose(f);
+        if (ok)
+            return true;
+    }
+    return false;
+}
+
+} // namespace Checkpoint
@@ -0,0 +1,269 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include "mpi.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+extern "C" {
+void dgetrf_(const int* m, const int* n, double* a, const int* lda, int* ipiv, int* info);
+void dgetrs_(const char* trans, const int* n, const int* nrhs, const double* a, const int* lda,
+             const int* ipiv, double* b, const int* ldb, int* info);
+}
+
+namespace Chord {
+
+struct Options {
+    double rate_max = 0.5;   // 收缩率 |F_k|/|F_{k-1}| 超过此值时下一步重新装配分解 Jacobian
+    bool broyden = true;     // 在两次分解之间做 Broyden 秩一修正
+    int max_updates = 20;    // Broyden 修正数上限，超过后重新分解
+};
+
+// 系统在当前状态的 LU 分解 Jacobian：列在各 rank 间分配计算，汇总到 rank 0 分解。
+// assemble() 需由所有 rank 共同调用，分解失败（奇异）时在所有 rank 上返回 false 并置空；
+// solve() 只在 rank 0 上有效，dgetrs 出错或结果非有限时返回 false。
+class Jacobian {
+public:
+    Jacobian() {
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
+        MPI_Comm_size(MPI_COMM_WORLD, &nproc_);
+    }
+
+    bool empty() const { return n_ == 0; }
+    int size() const { return n_; }
+
+    bool assemble(Kadath::System_of_eqs& syst) {
+        syst.vars_to_terms();
+        Kadath::Array<double> second(syst.sec_member());
+        int n = second.get_size(0);
+        if (syst.get_nbr_unknowns() != n)
+            throw std::runtime_error("Chord::Jacobian: system is not square");
+
+        // 列 i 由 rank i % nproc 计算
+        std::vector<double> local;
+        for (int i = rank_; i < n; i += nproc_) {
+            Kadath::Array<double> col(syst.do_col_J(i));
+            local.insert(local.end(), col.get_data(), col.get_data() + n);
+        }
+
+        std::vector<int> counts(nproc_), displs(nproc_);
+        for (int r = 0; r < nproc_; r++) {
+            int ncols = (n > r) ? (n - r + nproc_ - 1) / nproc_ : 0;
+            counts[r] = ncols * n;
+            displs[r] = (r == 0) ? 0 : displs[r - 1] + counts[r - 1];
+        }
+        std::vector<double> gathered(rank_ == 0 ? size_t(n) * n : 0);
+        MPI_Gatherv(local.data(), int(local.size()), MPI_DOUBLE,
+                    gathered.data(), counts.data(), displs.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+        int info = 0;
+        if (rank_ == 0) {
+            // 还原列序为 LAPACK 的列主序
+            lu_.assign(size_t(n) * n, 0.0);
+            for (int r = 0; r < nproc_; r++) {
+                const double* src = gathered.data() + displs[r];
+                for (int i = r; i < n; i += nproc_, src += n)
+                    std::copy(src, src + n, lu_.begin() + size_t(i) * n);
+            }
+            ipiv_.resize(n);
+            dgetrf_(&n, &n, lu_.data(), &n, ipiv_.data(), &info);
+        } else {
+            lu_.assign(1, 0.0);
+        }
+        MPI_Bcast(&info, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        n_ = info == 0 ? n : 0;
+        return info == 0;
+    }
+
+    // z <- J^{-1} z（trans=false）或 J^{-T} z（trans=true）
+    bool solve(std::vector<double>& z, bool trans = false) const {
+        if (n_ == 0)
+            return false;
+        int one = 1;
+        int info = 0;
+        dgetrs_(trans ? "T" : "N", &n_, &one, lu_.data(), &n_, ipiv_.data(), z.data(), &n_, &info);
+        if (info != 0)
+            return false;
+        for (double v : z)
+            if (!std::isfinite(v))
+                return false;
+        return true;
+    }
+
+private:
+    int rank_ = 0;
+    int nproc_ = 1;
+    int n_ = 0;
+    std::vector<double> lu_;
+    std::vector<int> ipiv_;
+};
+
+// 弦方法 / 拟 Newton 引擎：保留上一次 LU 分解的 Jacobian，在后续迭代（以及相邻扫描点之间）
+// 复用，仅在收缩变差时重新装配。修正量在 rank 0 上求出后广播给所有 rank，
+// 因此 step() 需由所有 rank 共同调用。旧分解给出无效修正时先重新分解再解；
+// 分解奇异时本步改用 do_newton 的完整步，不施加无效的修正量。
+class Engine {
+public:
+    explicit Engine(Kadath::System_of_eqs& syst, Options opts = Options())
+        : syst_(syst), opts_(opts) {
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
+    }
+
+    // 新的求解开始：保留分解，丢弃与上一参数点相关的 Broyden 历史
+    void begin() {
+        err_prev_ = -1;
+        have_step_ = false;
+        us_.clear();
+        vs_.clear();
+    }
+
+    void invalidate() { refactor_ = true; }
+    int nbr_factorizations() const { return nfact_; }
+
+    // 与 System_of_eqs::do_newton 相同的约定：返回 true 表示残差已低于 prec
+    bool step(double prec, double& error) {
+        syst_.vars_to_terms();
+        Kadath::Array<double> second(syst_.sec_member());
+        int n = second.get_size(0);
+        error = 0;
+        for (int i = 0; i < n; i++)
+            error = std::max(error, std::fabs(second(i)));
+        if (error < prec) {
+            err_prev_ = error;
+            return true;
+        }
+
+        if (err_prev_ > 0 && error > opts_.rate_max * err_prev_)
+            refactor_ = true;
+        if (nsince_ >= opts_.max_updates)
+            refactor_ = true;
+
+        std::vector<double> f(second.get_data(), second.get_data() + n);
+        std::vector<double> xx(n);
+
+        bool fresh = refactor_ || jac_.empty();
+        if (fresh) {
+            if (!factor())
+                return full_step(prec, error);
+        } else {
+            nsince_++;
+        }
+        if (nsince_ > 0 && opts_.broyden && have_step_ && rank_ == 0) {
+            // y = F_k - F_{k-1}，dx = -xx_{k-1}
+            std::vector<double> y(n);
+            for (int i = 0; i < n; i++)
+                y[i] = f[i] - f_prev_[i];
+            std::vector<double> hy(y);
+            bool ok = apply(hy, false);
+            std::vector<double> dx(n);
+            for (int i = 0; i < n; i++)
+                dx[i] = -xx_prev_[i];
+            double denom = 0;
+            for (int i = 0; i < n; i++)
+                denom += dx[i] * hy[i];
+            std::vector<double> v(dx);
+            if (ok && std::fabs(denom) > 1e-300 && apply(v, true)) {
+                std::vector<double> u(n);
+                for (int i = 0; i < n; i++)
+                    u[i] = (dx[i] - hy[i]) / denom;
+                us_.push_back(u);
+                vs_.push_back(v);
+            }
+        }
+
+        bool ok = solve(f, xx);
+        if (!ok && !fresh) {
+            if (!factor())
+                return full_step(prec, error);
+            ok = solve(f, xx);
+        }
+        if (!ok)
+            return full_step(prec, error);
+
+        Kadath::Array<double> update(n);
+        for (int i = 0; i < n; i++)
+            update.set(i) = xx[i];
+        syst_.newton_update_vars(update);
+
+        f_prev_ = f;
+        xx_prev_ = xx;
+        have_step_ = true;
+        err_prev_ = error;
+        return false;
+    }
+
+private:
+    // 重新装配分解 Jacobian，丢弃 Broyden 修正；奇异时返回 false（所有 rank 一致）
+    bool factor() {
+        nfact_++;
+        refactor_ = false;
+        us_.clear();
+        vs_.clear();
+        have_step_ = false;
+        nsince_ = 0;
+        return jac_.assemble(syst_);
+    }
+
+    // rank 0 上 xx = H f 后广播；修正量无效时所有 rank 返回 false
+    bool solve(const std::vector<double>& f, std::vector<double>& xx) {
+        int ok = 0;
+        if (rank_ == 0) {
+            xx = f;
+            ok = apply(xx, false) ? 1 : 0;
+        }
+        MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (ok)
+            MPI_Bcast(xx.data(), int(xx.size()), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        return ok != 0;
+    }
+
+    bool full_step(double prec, double& error) {
+        if (rank_ == 0)
+            std::cout << "Chord: singular Jacobian, taking a full Newton step" << std::endl;
+        refactor_ = true;
+        have_step_ = false;
+        err_prev_ = -1;
+        return syst_.do_newton(prec, error);
+    }
+
+    // z <- H z（trans=false）或 z <- H^T z（trans=true），H = J0^{-1} + sum_j u_j v_j^T
+    bool apply(std::vector<double>& z, bool trans) const {
+        int n = jac_.size();
+        std::vector<double> orig(z);
+        if (!jac_.solve(z, trans))
+            return false;
+        const std::vector<std::vector<double>>& left = trans ? vs_ : us_;
+        const std::vector<std::vector<double>>& right = trans ? us_ : vs_;
+        for (size_t j = 0; j < left.size(); j++) {
+            double a = 0;
+            for (int i = 0; i < n; i++)
+                a += right[j][i] * orig[i];
+            for (int i = 0; i < n; i++)
+                z[i] += left[j][i] * a;
+        }
+        for (double v : z)
+            if (!std::isfinite(v))
+                return false;
+        return true;
+    }
+
+    Kadath::System_of_eqs& syst_;
+    Options opts_;
+    Jacobian jac_;
+    int rank_ = 0;
+    int nfact_ = 0;
+    int nsince_ = 0;
+    bool refactor_ = true;
+    bool have_step_ = false;
+    double err_prev_ = -1;
+    std::vector<double> f_prev_;
+    std::vector<double> xx_prev_;
+    std::vector<std::vector<double>> us_;
+    std::vector<std::vector<double>> vs_;
+};
+
+} // namespace Chord
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include "utils/axi_jfnk.hpp"
+#include "utils/axi_session.hpp"
+#include "utils/checkpoint.hpp"
+#include "utils/newton_driver.hpp"
+#include "utils/regrid.hpp"
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Homotopy {
+
+// 一个求解阶段：中心约束 phi(Mc) = val、ome 为未知量，场在阶段之间原地传递
+struct Stage {
+    std::string name;
+    Axi::Model model;                 // Reduced: nu/phi/ome 简化系统；Full: 五场系统
+    std::vector<std::string> frozen;  // Full 模型中冻结为当前值的场（如 "incbt"）
+    std::string ramp;                 // 延拓参数："lambda" 或 "val"，空表示不延拓
+    double ramp_to;                   // 参数从进入本阶段时的值线性过渡到 ramp_to
+    int ramp_steps;                   // 过渡分几步，每步收敛后再前进
+    int resol;                        // 本阶段分辨率，0 表示最终分辨率；与上一阶段不同时谱插值
+    double prec;
+};
+
+// 各阶段共享的解：空间与五个场由 State 持有，分辨率变化时整体替换
+class State {
+public:
+    State(std::unique_ptr<Kadath::Space_polar> space, int kk, const Kadath::Point& Mc,
+          double omega, double lambda, double val)
+        : kk(kk), omega(omega), lambda(lambda), val(val), Mc(Mc), space_(std::move(space)) {
+        for (int i = 0; i < 5; i++)
+            fields_.emplace_back(new Kadath::Scalar(like(*space_, i)));
+    }
+
+    const Kadath::Space_polar& space() const { return *space_; }
+    int resol() const { return space_->get_domain(0)->get_nbr_points()(0); }
+
+    Kadath::Scalar& nu() { return *fields_[0]; }
+    Kadath::Scalar& incA() { return *fields_[1]; }
+    Kadath::Scalar& incB() { return *fields_[2]; }
+    Kadath::Scalar& incbt() { return *fields_[3]; }
+    Kadath::Scalar& phi() { return *fields_[4]; }
+
+    // 空间、参数与五个场，格式同 bosinit.dat 之后追加 val
+    void save(FILE* f) const {
+        space_->save(f);
+        fwrite_be(&kk, sizeof(int), 1, f);
+        fwrite_be(&omega, sizeof(double), 1, f);
+        fwrite_be(&lambda, sizeof(double), 1, f);
+        fwrite_be(&val, sizeof(double), 1, f);
+        for (const std::unique_ptr<Kadath::Scalar>& field : fields_)
+            field->save(f);
+    }
+
+    static std::unique_ptr<State> load(FILE* f, const Kadath::Point& Mc) {
+        std::unique_ptr<Kadath::Space_polar> space(new Kadath::Space_polar(f));
+        int kk = 0;
+        double omega = 0;
+        double lambda = 0;
+        double val = 0;
+        if (fread_be(&kk, sizeof(int), 1, f) != 1 || fread_be(&omega, sizeof(double), 1, f) != 1
+            || fread_be(&lambda, sizeof(double), 1, f) != 1 || fread_be(&val, sizeof(double), 1, f) != 1)
+            throw std::runtime_error("Homotopy: truncated state");
+        std::unique_ptr<State> st(new State(std::move(space), kk, Mc, omega, lambda, val));
+        for (int i = 0; i < 5; i++)
+            st->fields_[i].reset(new Kadath::Scalar(*st->space_, f));
+        Kadath::Param_tensor parameters;
+        parameters.set_m_quant() = kk;
+        st->phi().set_parameters() = parameters;
+        return st;
+    }
+
+    // 把全部场谱插值到新分辨率的同区域空间
+    void regrid(int resol) {
+        if (resol == this->resol())
+            return;
+        std::unique_ptr<Kadath::Space_polar> next = Regrid::with_resol(*space_, resol);
+        std::vector<std::unique_ptr<Kadath::Scalar>> moved;
+        for (int i = 0; i < 5; i++)
+            moved.emplace_back(new Kadath::Scalar(Regrid::transfer(*fields_[i], like(*next, i))));
+        fields_ = std::move(moved);
+        space_ = std::move(next);
+    }
+
+    int kk;
+    double omega;
+    double lambda;
+    double val;
+    Kadath::Point Mc;
+
+private:
+    // 零场模板：incB / incbt 取 rsint 的基底，phi 带 m 量子数
+    Kadath::Scalar like(const Kadath::Space_polar& space, int i) const {
+        if (i == 2 || i == 3) {
+            Kadath::Scalar l(Axi::make_rsint(space));
+            l.annule_hard();
+            return l;
+        }
+        return Regrid::std_like(space, i == 4 ? kk : -1);
+    }
+
+    std::unique_ptr<Kadath::Space_polar> space_;
+    std::vector<std::unique_ptr<Kadath::Scalar>> fields_;
+};
+
+struct Result {
+    bool converged = true;
+    int stage = -1;          // 失败的阶段下标
+    int ramp_step = 0;       // 失败时所在的延拓步（从 1 开始，0 表示无延拓）
+    Newton::Report report;   // 最后一次求解的报告
+};
+
+// 依次执行各阶段。solver 含义同 rbs：0 完整 Newton，1 弦方法，2 JFNK（仅用于未冻结场的
+// Full 阶段且分辨率高于 jfnk_coarse，其余阶段退回完整 Newton）。
+// ckpt 非空时每次 Newton 迭代后写检查点，并在收到 SIGTERM 后中断（Status::Interrupted）；
+// resume 非空时从其记录的阶段、延拓步与残差历史继续（st 须为从该检查点读出的状态）。
+inline Result run(State& st, const std::vector<Stage>& stages, int final_resol, Newton::Options opts,
+                  int solver, int jfnk_coarse, int rank,
+                  const Checkpoint::Writer* ckpt = nullptr, const Checkpoint::Progress* resume = nullptr) {
+    Result res;
+    size_t k0 = resume ? size_t(resume->stage) : 0;
+    if (k0 >= stages.size())
+        throw std::runtime_error("Homotopy: checkpoint stage is beyond the stage table");
+    if (ckpt)
+        opts.stop = Checkpoint::stop_requested;
+    for (size_t k = k0; k < stages.size(); k++) {
+        const Stage& s = stages[k];
+        bool resuming = resume && k == k0;
+        st.regrid(s.resol > 0 ? s.resol : final_resol);
+
+        Axi::Session session(st.space(), st.kk, st.nu(), st.incA(), st.incB(), st.incbt(), st.phi(),
+                             st.omega, st.lambda, true);
+        session.set_model(s.model);
+        for (const std::string& f : s.frozen)
+            session.freeze(f);
+        session.add_parameter("val", st.val);
+        session.add_point_constraint(st.Mc, "phi - val");
+
+        Newton::Options stage_opts(opts);
+        stage_opts.prec = s.prec;
+        std::unique_ptr<Axi::Jfnk_solver> jfnk;
+        if (solver == 1)
+            session.use_chord();
+        else if (solver == 2 && s.model == Axi::Model::Full && s.frozen.empty() && st.resol() > jfnk_coarse) {
+            ::Jfnk::Options jopts;
+            jopts.resol_coarse = jfnk_coarse;
+            jfnk.reset(new Axi::Jfnk_solver(session, jopts));
+            stage_opts.linesearch = false;
+        }
+
+        double* target = nullptr;
+        if (s.ramp == "lambda")
+            target = &st.lambda;
+        else if (s.ramp == "val")
+            target = &st.val;
+        else if (!s.ramp.empty())
+            throw std::runtime_error("Homotopy: unknown ramp parameter " + s.ramp);
+        int nsteps = (target && s.ramp_steps > 0) ? s.ramp_steps : 0;
+        double from = resuming ? resume->ramp_from : (target ? *target : 0);
+        int j0 = resuming ? resume->ramp_step : (nsteps > 0 ? 1 : 0);
+
+        for (int j = j0; j <= nsteps; j++) {
+            if (nsteps > 0)
+                *target = from + (s.ramp_to - from) * j / nsteps;
+
+            Checkpoint::Progress prog;
+            prog.stage = int(k);
+            prog.ramp_step = j;
+            prog.ramp_from = from;
+            Newton::Options step_opts(stage_opts);
+            if (resuming && j == j0) {
+                prog.history = resume->history;
+                prog.linesearch_from = resume->linesearch_from;
+                step_opts.resume_history = resume->history;
+                step_opts.resume_linesearch_from = resume->linesearch_from;
+            }
+
+            if (rank == 0) {
+                std::cout << "Stage " << k << " (" << s.name << "): resol = " << st.resol();
+                if (nsteps > 0)
+                    std::cout << ", " << s.ramp << " = " << *target << " [" << j << "/" << nsteps << "]";
+                std::cout << std::endl;
+            }
+            session.begin_solve();
+            res.report = session.solve(step_opts, [&](int ite, double conv, bool ls) {
+                if (rank == 0)
+                    std::cout << "Newton iteration " << ite << " " << conv << " " << st.omega
+                              << (ls ? " (line search)" : "") << std::endl;
+                if (ckpt) {
+                    if (ls && prog.linesearch_from < 0)
+                        prog.linesearch_from = int(prog.history.size());
+                    prog.history.push_back(conv);
+                    ckpt->write(prog, [&](FILE* f) { st.save(f); });
+                }
+            });
+            if (!res.report.converged()) {
+                res.converged = false;
+                res.stage = int(k);
+                res.ramp_step = j;
+                return res;
+            }
+        }
+    }
+    return res;
+}
+
+} // namespace Homotopy
@@ -1,12 +1,19 @@
 #pragma once
 
 #include "kadath_polar.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <cstring>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <functional>
+#include <map>
+#include <unistd.h>
+#include <vector>
 
 namespace Io {
 
@@ -17,53 +24,385 @@ enum class SolutionKind {
     Spherical
 };
 
-inline SolutionKind detect_kind(const char* path, int& kk_guess) {
-    FILE* f = fopen(path, "r");
-    if (!f) throw std::runtime_error(std::string("Cannot open file: ") + path);
-    Kadath::Space_polar space(f);
-    (void)space;
-    long pos = ftell(f);
-    int kk = 0;
-    size_t r = Kadath::fread_be(&kk, sizeof(int), 1, f);
-    fclose(f);
-    kk_guess = kk;
-    if (r == 1 && std::abs(kk) <= KK_MAX_ABS) {
-        return SolutionKind::Axisymmetric;
-    }
-    return SolutionKind::Spherical;
+// 写出格式：Indexed 为带索引的新格式（默认），Legacy 为原来的顺序格式，
+// Native 为带索引格式但场按本机字节序存谱系数（ENC_COEF_*，读写都是整块拷贝）
+enum class Format {
+    Indexed,
+    Legacy,
+    Native
+};
+
+// 带索引格式（版本 2/3），整数与浮点均为大端（ENC_COEF_* 场的系数除外）：
+//   magic[8] "BSSOLIDX" | version:int | kind:int
+//   nparam:int | nparam × (name[16], value:double)          参数块（kk、omega、lambda，压缩时另有 ctol）
+//   nfield:int | space_offset:u64 | nfield × (name[16], offset:u64, encoding:int)   各块在文件中的字节偏移
+//   Space_polar | 各场
+// 读取时只打开一次文件，按偏移直接定位需要的场。版本 1 的场表没有 encoding 列（均为 Scalar::save）；
+// 含 ENC_COEF_* 场的文件记为版本 3，旧程序读到时报版本不支持而不是误读。
+static const char MAGIC[8] = {'B', 'S', 'S', 'O', 'L', 'I', 'D', 'X'};
+static constexpr int VERSION = 3;
+
+// 场的存储方式
+static constexpr int ENC_RAW = 0;       // Scalar::save
+static constexpr int ENC_TRIMMED = 1;   // 谱系数截尾，见 detail::write_trimmed
+static constexpr int ENC_COEF_LE = 2;   // 谱系数整块存储，小端，见 detail::write_coefs
+static constexpr int ENC_COEF_BE = 3;   // 同上，大端
+static constexpr int NAME_LEN = 16;
+
+inline const std::vector<std::string>& field_names(SolutionKind kind) {
+    static const std::vector<std::string> axi = {"nu", "incA", "incB", "incbt", "phi"};
+    static const std::vector<std::string> sph = {"psi", "nu", "phi"};
+    return kind == SolutionKind::Axisymmetric ? axi : sph;
 }
 
 inline bool looks_like_lambda(double val) {
     return std::isfinite(val) && std::fabs(val) < 1e3;
 }
 
-template <class Fn>
-inline void load_axisymmetric(const char* path, double lambda_default, Fn&& fn) {
-    FILE* f = fopen(path, "r");
-    if (!f) throw std::runtime_error(std::string("Cannot open file: ") + path);
+namespace detail {
 
-    Kadath::Space_polar space(f);
+inline void write_u64(std::uint64_t v, FILE* f) {
+    unsigned char b[8];
+    for (int i = 0; i < 8; i++)
+        b[i] = (unsigned char)(v >> (56 - 8 * i));
+    fwrite(b, 1, 8, f);
+}
+
+inline bool read_u64(std::uint64_t& v, FILE* f) {
+    unsigned char b[8];
+    if (fread(b, 1, 8, f) != 8)
+        return false;
+    v = 0;
+    for (int i = 0; i < 8; i++)
+        v = (v << 8) | b[i];
+    return true;
+}
+
+inline void write_name(const std::string& name, FILE* f) {
+    char buf[NAME_LEN] = {};
+    std::strncpy(buf, name.c_str(), NAME_LEN - 1);
+    fwrite(buf, 1, NAME_LEN, f);
+}
+
+inline bool read_name(std::string& name, FILE* f) {
+    char buf[NAME_LEN + 1] = {};
+    if (fread(buf, 1, NAME_LEN, f) != size_t(NAME_LEN))
+        return false;
+    name = buf;
+    return true;
+}
+
+inline bool is_indexed(FILE* f) {
+    char magic[sizeof(MAGIC)];
+    bool ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    if (!ok)
+        rewind(f);
+    return ok;
+}
+
+} // namespace detail
+
+// 索引头：参数与各块偏移
+struct Header {
+    int version = 0;       // 0 表示旧格式
+    SolutionKind kind = SolutionKind::Axisymmetric;
+    std::vector<std::string> param_names;
+    std::vector<double> params;
+    std::uint64_t space_offset = 0;
+    std::vector<std::string> names;
+    std::vector<std::uint64_t> offsets;
+    std::vector<int> encodings;
+
+    bool has_param(const std::string& name) const {
+        for (const std::string& n : param_names)
+            if (n == name)
+                return true;
+        return false;
+    }
+
+    double param(const std::string& name, double fallback = 0.0) const {
+        for (size_t i = 0; i < param_names.size(); i++)
+            if (param_names[i] == name)
+                return params[i];
+        return fallback;
+    }
+};
+
+namespace detail {
+
+// 文件位于 magic 之后
+inline Header read_header(FILE* f, const char* path) {
+    Header h;
+    int kind = 0;
+    int nparam = 0;
+    int nfield = 0;
+    bool ok = Kadath::fread_be(&h.version, sizeof(int), 1, f) == 1
+        && Kadath::fread_be(&kind, sizeof(int), 1, f) == 1
+        && Kadath::fread_be(&nparam, sizeof(int), 1, f) == 1 && nparam >= 0 && nparam < 64;
+    if (ok && h.version > VERSION)
+        throw std::runtime_error(std::string("Unsupported solution file version in ") + path);
+    for (int i = 0; ok && i < nparam; i++) {
+        std::string name;
+        double v = 0;
+        ok = read_name(name, f) && Kadath::fread_be(&v, sizeof(double), 1, f) == 1;
+        h.param_names.push_back(name);
+        h.params.push_back(v);
+    }
+    ok = ok && Kadath::fread_be(&nfield, sizeof(int), 1, f) == 1 && nfield >= 0 && nfield < 64
+        && read_u64(h.space_offset, f);
+    for (int i = 0; ok && i < nfield; i++) {
+        std::string name;
+        std::uint64_t off = 0;
+        int enc = ENC_RAW;
+        ok = read_name(name, f) && read_u64(off, f);
+        if (ok && h.version >= 2)
+            ok = Kadath::fread_be(&enc, sizeof(int), 1, f) == 1;
+        h.names.push_back(name);
+        h.offsets.push_back(off);
+        h.encodings.push_back(enc);
+    }
+    if (!ok)
+        throw std::runtime_error(std::string("Truncated solution header in ") + path);
+    h.kind = kind == 0 ? SolutionKind::Axisymmetric : SolutionKind::Spherical;
+    return h;
+}
+
+// 谱系数截尾：每个域先写基底与零域标志，系数按 Index 的遍历顺序分成长度为径向系数数的段，
+// 每段只保留到最后一个 |c| > tol * max|c| 的系数（max 取该场该域，给出 scale 时取 scale 的），
+// 其余在读回时补零。tol = 0 时只去掉精确为零的尾部，是无损的。
+inline double max_coef(const Kadath::Val_domain& v, const Kadath::Dim_array& dims) {
+    if (v.check_if_zero())
+        return 0;
+    v.coef();
+    double m = 0;
+    Kadath::Index idx(dims);
+    do {
+        m = std::max(m, std::fabs(v.get_coef()(idx)));
+    } while (idx.inc());
+    return m;
+}
+
+inline void write_trimmed(const Kadath::Scalar& s, double tol, FILE* f, const Kadath::Scalar* scale = nullptr) {
+    const Kadath::Space& space = s.get_space();
+    for (int d = 0; d < space.get_nbr_domains(); d++) {
+        const Kadath::Val_domain& v = s(d);
+        v.get_base().save(f);
+        int zero = v.check_if_zero() ? 1 : 0;
+        Kadath::fwrite_be(&zero, sizeof(int), 1, f);
+        if (zero)
+            continue;
+        v.coef();
+        const Kadath::Array<double>& cf = v.get_coef();
+        Kadath::Dim_array dims(space.get_domain(d)->get_nbr_coefs());
+        std::vector<double> all;
+        Kadath::Index idx(dims);
+        do {
+            all.push_back(cf(idx));
+        } while (idx.inc());
+        double cmax = 0;
+        for (double c : all)
+            cmax = std::max(cmax, std::fabs(c));
+        if (scale)
+            cmax = max_coef((*scale)(d), dims);
+        double cut = tol * cmax;
+
+        int run = dims(0);
+        int nruns = int(all.size()) / run;
+        std::vector<int> keep(nruns, 0);
+        for (int k = 0; k < nruns; k++)
+            for (int i = run - 1; i >= 0; i--)
+                if (all[k * run + i] != 0 && std::fabs(all[k * run + i]) > cut) {
+                    keep[k] = i + 1;
+                    break;
+                }
+        Kadath::fwrite_be(&nruns, sizeof(int), 1, f);
+        Kadath::fwrite_be(&run, sizeof(int), 1, f);
+        Kadath::fwrite_be(keep.data(), sizeof(int), nruns, f);
+        for (int k = 0; k < nruns; k++)
+            if (keep[k] > 0)
+                Kadath::fwrite_be(&all[k * run], sizeof(double), keep[k], f);
+    }
+}
+
+inline bool host_little_endian() {
+    const std::uint16_t one = 1;
+    return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
+
+inline size_t nbr_coefs(const Kadath::Space& space, int d) {
+    Kadath::Dim_array dims(space.get_domain(d)->get_nbr_coefs());
+    size_t total = 1;
+    for (int k = 0; k < dims.get_ndim(); k++)
+        total *= size_t(dims(k));
+    return total;
+}
+
+// 谱系数整块存储：每个域写基底、零域标志与系数个数（大端），之后是系数 Array 的连续存储
+// （第一个下标变化最快，即 Index 的遍历顺序），字节序为本机序并由 encoding 声明；
+// 读写都直接对 Array 的数据块 fwrite / fread，读者字节序不同时原地逐个翻转
+inline void write_coefs(const Kadath::Scalar& s, FILE* f) {
+    const Kadath::Space& space = s.get_space();
+    for (int d = 0; d < space.get_nbr_domains(); d++) {
+        const Kadath::Val_domain& v = s(d);
+        v.get_base().save(f);
+        int zero = v.check_if_zero() ? 1 : 0;
+        Kadath::fwrite_be(&zero, sizeof(int), 1, f);
+        if (zero)
+            continue;
+        v.coef();
+        const Kadath::Array<double>& cf = v.get_coef();
+        size_t total = nbr_coefs(space, d);
+        if (size_t(cf.get_nbr()) != total)
+            throw std::runtime_error("write_coefs: coefficient array does not match the domain");
+        int n = int(total);
+        Kadath::fwrite_be(&n, sizeof(int), 1, f);
+        fwrite(cf.get_data(), sizeof(double), total, f);
+    }
+}
+
+inline Kadath::Scalar* read_coefs(const Kadath::Space_polar& space, FILE* f, const char* path, bool little) {
+    std::unique_ptr<Kadath::Scalar> s(new Kadath::Scalar(space));
+    for (int d = 0; d < space.get_nbr_domains(); d++) {
+        Kadath::Base_spectral base(f);
+        int zero = 0;
+        if (Kadath::fread_be(&zero, sizeof(int), 1, f) != 1)
+            throw std::runtime_error(std::string("Truncated field in ") + path);
+        Kadath::Val_domain& v = s->set_domain(d);
+        if (zero) {
+            v.annule_hard();
+            v.set_base() = base;
+            continue;
+        }
+        size_t total = nbr_coefs(space, d);
+        int n = 0;
+        if (Kadath::fread_be(&n, sizeof(int), 1, f) != 1 || n != int(total))
+            throw std::runtime_error(std::string("Corrupt field in ") + path);
+        v.set_in_coef();
+        v.set_base() = base;
+        Kadath::Array<double>& cf = v.set_coef();
+        if (size_t(cf.get_nbr()) != total)
+            throw std::runtime_error(std::string("Coefficient array does not match the domain in ") + path);
+        double* data = cf.set_data();
+        if (fread(data, sizeof(double), total, f) != total)
+            throw std::runtime_error(std::string("Corrupt field in ") + path);
+        if (little != host_little_endian())
+            for (size_t k = 0; k < total; k++) {
+                unsigned char* b = reinterpret_cast<unsigned char*>(data + k);
+                std::reverse(b, b + sizeof(double));
+            }
+    }
+    return s.release();
+}
+
+inline Kadath::Scalar* read_trimmed(const Kadath::Space_polar& space, FILE* f, const char* path) {
+    std::unique_ptr<Kadath::Scalar> s(new Kadath::Scalar(space));
+    for (int d = 0; d < space.get_nbr_domains(); d++) {
+        Kadath::Base_spectral base(f);
+        int zero = 0;
+        if (Kadath::fread_be(&zero, sizeof(int), 1, f) != 1)
+            throw std::runtime_error(std::string("Truncated compressed field in ") + path);
+        Kadath::Val_domain& v = s->set_domain(d);
+        if (zero) {
+            v.annule_hard();
+            v.set_base() = base;
+            continue;
+        }
+        Kadath::Dim_array dims(space.get_domain(d)->get_nbr_coefs());
+        int nruns = 0;
+        int run = 0;
+        bool ok = Kadath::fread_be(&nruns, sizeof(int), 1, f) == 1 && Kadath::fread_be(&run, sizeof(int), 1, f) == 1
+            && run == dims(0) && nruns >= 0;
+        std::vector<int> keep(ok ? nruns : 0);
+        ok = ok && Kadath::fread_be(keep.data(), sizeof(int), nruns, f) == size_t(nruns);
+        std::vector<double> all(ok ? size_t(nruns) * run : 0, 0.0);
+        for (int k = 0; ok && k < nruns; k++)
+            ok = keep[k] >= 0 && keep[k] <= run
+                && (keep[k] == 0 || Kadath::fread_be(&all[k * run], sizeof(double), keep[k], f) == size_t(keep[k]));
+        if (!ok)
+            throw std::runtime_error(std::string("Corrupt compressed field in ") + path);
+
+        v.set_in_coef();
+        v.set_base() = base;
+        Kadath::Index idx(dims);
+        size_t n = 0;
+        do {
+            v.set_coef(idx) = n < all.size() ? all[n] : 0.0;
+            n++;
+        } while (idx.inc());
+    }
+    return s.release();
+}
+
+} // namespace detail
+
+// 读入内存的解：只含请求的场；onto 非空时场直接构造在调用方的空间上（须与文件中的网格一致）
+struct Solution {
+    SolutionKind kind = SolutionKind::Axisymmetric;
+    int version = 0;
     int kk = 0;
     double omega = 0.0;
-    double lambda = lambda_default;
+    double lambda = 0.0;
+    bool has_lambda = false;
+    std::unique_ptr<Kadath::Space_polar> own_space;
+    const Kadath::Space_polar* space = nullptr;
+    std::vector<std::string> names;
+    std::vector<std::unique_ptr<Kadath::Scalar>> fields;
+
+    bool has(const std::string& name) const {
+        for (const std::string& n : names)
+            if (n == name)
+                return true;
+        return false;
+    }
+
+    const Kadath::Scalar& field(const std::string& name) const {
+        for (size_t i = 0; i < names.size(); i++)
+            if (names[i] == name)
+                return *fields[i];
+        throw std::runtime_error("Solution: field " + name + " was not loaded");
+    }
+};
+
+namespace detail {
+
+inline bool wanted(const std::vector<std::string>& only, const std::string& name) {
+    if (only.empty())
+        return true;
+    for (const std::string& n : only)
+        if (n == name)
+            return true;
+    return false;
+}
 
-    if (Kadath::fread_be(&kk, sizeof(int), 1, f) != 1)
-        throw std::runtime_error("Failed to read kk");
-    if (Kadath::fread_be(&omega, sizeof(double), 1, f) != 1)
-        throw std::runtime_error("Failed to read omega");
+// 旧格式：顺序读空间与参数，kk 按 |kk| <= KK_MAX_ABS 判型，lambda 通过试读下一个 Scalar 的头部判断
+inline void read_legacy(FILE* f, const char* path, double lambda_default, const std::vector<std::string>& only,
+                        const Kadath::Space_polar* onto, Solution& sol) {
+    std::unique_ptr<Kadath::Space_polar> space(new Kadath::Space_polar(f));
+    long after_space = ftell(f);
+    int kk = 0;
+    size_t r = Kadath::fread_be(&kk, sizeof(int), 1, f);
+    sol.kind = (r == 1 && std::abs(kk) <= KK_MAX_ABS) ? SolutionKind::Axisymmetric : SolutionKind::Spherical;
+    if (sol.kind == SolutionKind::Axisymmetric)
+        sol.kk = kk;
+    else
+        fseek(f, after_space, SEEK_SET);
+
+    if (Kadath::fread_be(&sol.omega, sizeof(double), 1, f) != 1)
+        throw std::runtime_error(std::string("Failed to read omega from ") + path);
 
     long pos = ftell(f);
     double lambda_probe = lambda_default;
-    bool has_lambda = false;
+    sol.lambda = lambda_default;
+    sol.has_lambda = false;
     if (Kadath::fread_be(&lambda_probe, sizeof(double), 1, f) == 1 && looks_like_lambda(lambda_probe)) {
         long after_lambda = ftell(f);
         int base_flag = 0;
         int ndim_flag = 0;
         bool peek_ok = Kadath::fread_be(&base_flag, sizeof(int), 1, f) == 1 &&
                        Kadath::fread_be(&ndim_flag, sizeof(int), 1, f) == 1;
-        if (peek_ok && (base_flag == 0 || base_flag == 1) && ndim_flag == space.get_ndim()) {
-            lambda = lambda_probe;
-            has_lambda = true;
+        if (peek_ok && (base_flag == 0 || base_flag == 1) && ndim_flag == space->get_ndim()) {
+            sol.lambda = lambda_probe;
+            sol.has_lambda = true;
             fseek(f, after_lambda, SEEK_SET);
         } else {
             fseek(f, pos, SEEK_SET);
@@ -72,57 +411,289 @@ inline void load_axisymmetric(const char* path, double lambda_default, Fn&& fn)
         fseek(f, pos, SEEK_SET);
     }
 
-    Kadath::Scalar nu   (space, f);
-    Kadath::Scalar incA (space, f);
-    Kadath::Scalar incB (space, f);
-    Kadath::Scalar incbt(space, f);
-    Kadath::Scalar phi  (space, f);
+    // 顺序格式必须逐个读过不需要的场
+    const Kadath::Space_polar& target = onto ? *onto : *space;
+    for (const std::string& name : field_names(sol.kind)) {
+        std::unique_ptr<Kadath::Scalar> s(new Kadath::Scalar(target, f));
+        if (!wanted(only, name))
+            continue;
+        sol.names.push_back(name);
+        sol.fields.push_back(std::move(s));
+    }
+    if (!onto)
+        sol.own_space = std::move(space);
+    sol.space = &target;
+}
+
+} // namespace detail
 
+// 打开一次文件读入解；only 为空时读全部场。旧格式文件走原来的顺序解析路径。
+inline Solution read_solution(const char* path, const std::vector<std::string>& only = {},
+                              const Kadath::Space_polar* onto = nullptr, double lambda_default = 0.0) {
+    FILE* f = fopen(path, "r");
+    if (!f) throw std::runtime_error(std::string("Cannot open file: ") + path);
+    Solution sol;
+    try {
+        if (!detail::is_indexed(f)) {
+            detail::read_legacy(f, path, lambda_default, only, onto, sol);
+        } else {
+            Header h = detail::read_header(f, path);
+            sol.version = h.version;
+            sol.kind = h.kind;
+            sol.kk = int(std::lround(h.param("kk")));
+            sol.omega = h.param("omega");
+            sol.has_lambda = h.has_param("lambda");
+            sol.lambda = h.param("lambda", lambda_default);
+            if (!onto) {
+                fseek(f, long(h.space_offset), SEEK_SET);
+                sol.own_space.reset(new Kadath::Space_polar(f));
+            }
+            sol.space = onto ? onto : sol.own_space.get();
+            for (size_t i = 0; i < h.names.size(); i++) {
+                if (!detail::wanted(only, h.names[i]))
+                    continue;
+                fseek(f, long(h.offsets[i]), SEEK_SET);
+                sol.names.push_back(h.names[i]);
+                if (h.encodings[i] == ENC_TRIMMED)
+                    sol.fields.emplace_back(detail::read_trimmed(*sol.space, f, path));
+                else if (h.encodings[i] == ENC_COEF_LE || h.encodings[i] == ENC_COEF_BE)
+                    sol.fields.emplace_back(detail::read_coefs(*sol.space, f, path, h.encodings[i] == ENC_COEF_LE));
+                else if (h.encodings[i] == ENC_RAW)
+                    sol.fields.emplace_back(new Kadath::Scalar(*sol.space, f));
+                else
+                    throw std::runtime_error(std::string("Unknown field encoding in ") + path);
+            }
+        }
+        for (const std::string& name : only)
+            if (!sol.has(name))
+                throw std::runtime_error(std::string("Field ") + name + " not found in " + path);
+    } catch (...) {
+        fclose(f);
+        throw;
+    }
     fclose(f);
-
-    fn(space, kk, omega, lambda, nu, incA, incB, incbt, phi, has_lambda);
+    return sol;
 }
 
-template <class Fn>
-inline void load_spherical(const char* path, double lambda_default, Fn&& fn) {
+// 只读出文件中的空间（用于比较网格）
+inline std::unique_ptr<Kadath::Space_polar> read_space(const char* path) {
     FILE* f = fopen(path, "r");
     if (!f) throw std::runtime_error(std::string("Cannot open file: ") + path);
+    std::unique_ptr<Kadath::Space_polar> space;
+    try {
+        if (detail::is_indexed(f)) {
+            Header h = detail::read_header(f, path);
+            fseek(f, long(h.space_offset), SEEK_SET);
+        }
+        space.reset(new Kadath::Space_polar(f));
+    } catch (...) {
+        fclose(f);
+        throw;
+    }
+    fclose(f);
+    return space;
+}
 
-    Kadath::Space_polar space(f);
-    double omega = 0.0;
-    double lambda = lambda_default;
+// 按空间块的原始字节复用已反序列化的网格，批量读同一网格上的大量解时每个网格只构造一次 Space_polar。
+// 只对新格式有效（空间块的范围由头部给出）；旧格式返回 nullptr，由 read_solution 自行解析。
+class Space_cache {
+public:
+    const Kadath::Space_polar* get(const char* path) {
+        FILE* f = fopen(path, "r");
+        if (!f) throw std::runtime_error(std::string("Cannot open file: ") + path);
+        std::string bytes;
+        try {
+            if (!detail::is_indexed(f)) {
+                fclose(f);
+                return nullptr;
+            }
+            Header h = detail::read_header(f, path);
+            std::uint64_t end = 0;
+            for (std::uint64_t off : h.offsets)
+                if (off > h.space_offset && (end == 0 || off < end))
+                    end = off;
+            if (end == 0)
+                throw std::runtime_error(std::string("No field data in ") + path);
+            bytes.resize(size_t(end - h.space_offset));
+            fseek(f, long(h.space_offset), SEEK_SET);
+            if (fread(&bytes[0], 1, bytes.size(), f) != bytes.size())
+                throw std::runtime_error(std::string("Truncated space in ") + path);
+        } catch (...) {
+            fclose(f);
+            throw;
+        }
+        fclose(f);
+        std::unique_ptr<Kadath::Space_polar>& space = spaces_[bytes];
+        if (!space)
+            space = read_space(path);
+        return space.get();
+    }
 
-    if (Kadath::fread_be(&omega, sizeof(double), 1, f) != 1)
-        throw std::runtime_error("Failed to read omega");
+    size_t size() const { return spaces_.size(); }
 
-    long pos = ftell(f);
-    double lambda_probe = lambda_default;
-    bool has_lambda = false;
-    if (Kadath::fread_be(&lambda_probe, sizeof(double), 1, f) == 1 && looks_like_lambda(lambda_probe)) {
-        long after_lambda = ftell(f);
-        int base_flag = 0;
-        int ndim_flag = 0;
-        bool peek_ok = Kadath::fread_be(&base_flag, sizeof(int), 1, f) == 1 &&
-                       Kadath::fread_be(&ndim_flag, sizeof(int), 1, f) == 1;
-        if (peek_ok && (base_flag == 0 || base_flag == 1) && ndim_flag == space.get_ndim()) {
-            lambda = lambda_probe;
-            has_lambda = true;
-            fseek(f, after_lambda, SEEK_SET);
-        } else {
-            fseek(f, pos, SEEK_SET);
+private:
+    std::map<std::string, std::unique_ptr<Kadath::Space_polar>> spaces_;
+};
+
+// 新格式只读头部；旧格式仍需反序列化空间后按 kk 的范围猜测
+inline SolutionKind detect_kind(const char* path, int& kk_guess) {
+    FILE* f = fopen(path, "r");
+    if (!f) throw std::runtime_error(std::string("Cannot open file: ") + path);
+    if (detail::is_indexed(f)) {
+        Header h;
+        try {
+            h = detail::read_header(f, path);
+        } catch (...) {
+            fclose(f);
+            throw;
         }
+        fclose(f);
+        kk_guess = int(std::lround(h.param("kk")));
+        return h.kind;
+    }
+    Kadath::Space_polar space(f);
+    (void)space;
+    int kk = 0;
+    size_t r = Kadath::fread_be(&kk, sizeof(int), 1, f);
+    fclose(f);
+    kk_guess = kk;
+    if (r == 1 && std::abs(kk) <= KK_MAX_ABS) {
+        return SolutionKind::Axisymmetric;
+    }
+    return SolutionKind::Spherical;
+}
+
+template <class Fn>
+inline void load_axisymmetric(const char* path, double lambda_default, Fn&& fn) {
+    Solution sol = read_solution(path, {}, nullptr, lambda_default);
+    if (sol.kind != SolutionKind::Axisymmetric)
+        throw std::runtime_error(std::string("Not an axisymmetric solution: ") + path);
+    fn(*sol.space, sol.kk, sol.omega, sol.lambda, sol.field("nu"), sol.field("incA"), sol.field("incB"),
+       sol.field("incbt"), sol.field("phi"), sol.has_lambda);
+}
+
+template <class Fn>
+inline void load_spherical(const char* path, double lambda_default, Fn&& fn) {
+    Solution sol = read_solution(path, {}, nullptr, lambda_default);
+    if (sol.kind != SolutionKind::Spherical)
+        throw std::runtime_error(std::string("Not a spherical solution: ") + path);
+    fn(*sol.space, sol.omega, sol.lambda, sol.field("psi"), sol.field("nu"), sol.field("phi"), sol.has_lambda);
+}
+
+// 带索引格式：先写占位的偏移表，写完各块后回填。trim_tol >= 0 时各场按谱系数截尾存储
+inline void write_indexed(FILE* f, SolutionKind kind,
+                          std::vector<std::string> param_names, std::vector<double> params,
+                          const Kadath::Space_polar& space, const std::vector<const Kadath::Scalar*>& fields,
+                          double trim_tol = -1, bool native = false) {
+    const std::vector<std::string>& names = field_names(kind);
+    // 截尾优先（数据已经很小），否则 native 时整块存本机字节序的系数
+    int enc = trim_tol >= 0 ? ENC_TRIMMED
+        : (native ? (detail::host_little_endian() ? ENC_COEF_LE : ENC_COEF_BE) : ENC_RAW);
+    if (enc == ENC_TRIMMED) {
+        param_names.push_back("ctol");
+        params.push_back(trim_tol);
+    }
+    fwrite(MAGIC, 1, sizeof(MAGIC), f);
+    int version = (enc == ENC_COEF_LE || enc == ENC_COEF_BE) ? 3 : 2;
+    int kind_tag = kind == SolutionKind::Axisymmetric ? 0 : 1;
+    int nparam = int(params.size());
+    int nfield = int(names.size());
+    Kadath::fwrite_be(&version, sizeof(int), 1, f);
+    Kadath::fwrite_be(&kind_tag, sizeof(int), 1, f);
+    Kadath::fwrite_be(&nparam, sizeof(int), 1, f);
+    for (int i = 0; i < nparam; i++) {
+        detail::write_name(param_names[i], f);
+        Kadath::fwrite_be(&params[i], sizeof(double), 1, f);
+    }
+    Kadath::fwrite_be(&nfield, sizeof(int), 1, f);
+    long table = ftell(f);
+    detail::write_u64(0, f);
+    for (int i = 0; i < nfield; i++) {
+        detail::write_name(names[i], f);
+        detail::write_u64(0, f);
+        Kadath::fwrite_be(&enc, sizeof(int), 1, f);
+    }
+
+    std::vector<std::uint64_t> offsets;
+    std::uint64_t space_offset = std::uint64_t(ftell(f));
+    space.save(f);
+    for (const Kadath::Scalar* s : fields) {
+        offsets.push_back(std::uint64_t(ftell(f)));
+        if (enc == ENC_TRIMMED)
+            detail::write_trimmed(*s, trim_tol, f);
+        else if (enc == ENC_RAW)
+            s->save(f);
+        else
+            detail::write_coefs(*s, f);
+    }
+
+    long end = ftell(f);
+    fseek(f, table, SEEK_SET);
+    detail::write_u64(space_offset, f);
+    for (int i = 0; i < nfield; i++) {
+        detail::write_name(names[i], f);
+        detail::write_u64(offsets[i], f);
+        Kadath::fwrite_be(&enc, sizeof(int), 1, f);
+    }
+    fseek(f, end, SEEK_SET);
+}
+
+inline void write_axisymmetric(FILE* f,
+                               const Kadath::Space_polar& space,
+                               int kk,
+                               double omega,
+                               double lambda,
+                               const Kadath::Scalar& nu,
+                               const Kadath::Scalar& incA,
+                               const Kadath::Scalar& incB,
+                               const Kadath::Scalar& incbt,
+                               const Kadath::Scalar& phi,
+                               Format format = Format::Indexed,
+                               double trim_tol = -1) {
+    if (format == Format::Legacy && trim_tol >= 0)
+        throw std::runtime_error("Coefficient trimming needs the indexed format");
+    if (format != Format::Legacy) {
+        write_indexed(f, SolutionKind::Axisymmetric, {"kk", "omega", "lambda"}, {double(kk), omega, lambda},
+                      space, {&nu, &incA, &incB, &incbt, &phi}, trim_tol, format == Format::Native);
     } else {
-        fseek(f, pos, SEEK_SET);
+        space.save(f);
+        Kadath::fwrite_be(&kk, sizeof(int), 1, f);
+        Kadath::fwrite_be(&omega, sizeof(double), 1, f);
+        Kadath::fwrite_be(&lambda, sizeof(double), 1, f);
+        nu.save(f);
+        incA.save(f);
+        incB.save(f);
+        incbt.save(f);
+        phi.save(f);
     }
+}
 
-    Kadath::Scalar psi(space, f);
-    Kadath::Scalar nu (space, f);
-    Kadath::Scalar phi(space, f);
+namespace detail {
 
-    fclose(f);
-    fn(space, omega, lambda, psi, nu, phi, has_lambda);
+// 先写 <path>.tmp，检查 ferror / fflush / fsync / fclose 后 rename 为 path；任一步失败时删除临时文件并抛出，
+// 磁盘满等错误不会在最终文件名下留下截断的解
+inline void save_atomic(const char* path, const std::function<void(FILE*)>& write) {
+    std::string tmp = std::string(path) + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f) throw std::runtime_error(std::string("Cannot open for write: ") + tmp);
+    bool ok = false;
+    try {
+        write(f);
+        ok = !ferror(f) && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    } catch (...) {
+        fclose(f);
+        unlink(tmp.c_str());
+        throw;
+    }
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path) != 0) {
+        unlink(tmp.c_str());
+        throw std::runtime_error(std::string("Cannot write ") + path);
+    }
 }
 
+} // namespace detail
+
 inline void save_axisymmetric(const char* path,
                               const Kadath::Space_polar& space,
                               int kk,
@@ -132,19 +703,48 @@ inline void save_axisymmetric(const char* path,
                               const Kadath::Scalar& incA,
                               const Kadath::Scalar& incB,
                               const Kadath::Scalar& incbt,
-                              const Kadath::Scalar& phi) {
-    FILE* f = fopen(path, "w");
-    if (!f) throw std::runtime_error(std::string("Cannot open for write: ") + path);
-    space.save(f);
-    Kadath::fwrite_be(&kk, sizeof(int), 1, f);
-    Kadath::fwrite_be(&omega, sizeof(double), 1, f);
-    Kadath::fwrite_be(&lambda, sizeof(double), 1, f);
-    nu.save(f);
-    incA.save(f);
-    incB.save(f);
-    incbt.save(f);
-    phi.save(f);
-    fclose(f);
+                              const Kadath::Scalar& phi,
+                              Format format = Format::Indexed,
+                              double trim_tol = -1) {
+    if (format == Format::Legacy && trim_tol >= 0)
+        throw std::runtime_error("Coefficient trimming needs the indexed format");
+    detail::save_atomic(path, [&](FILE* f) {
+        write_axisymmetric(f, space, kk, omega, lambda, nu, incA, incB, incbt, phi, format, trim_tol);
+    });
+}
+
+// 把解序列化到内存（与写文件逐字节相同），供后台线程落盘：Kadath 的调用都留在调用线程
+inline std::string encode_axisymmetric(const Kadath::Space_polar& space,
+                                       int kk,
+                                       double omega,
+                                       double lambda,
+                                       const Kadath::Scalar& nu,
+                                       const Kadath::Scalar& incA,
+                                       const Kadath::Scalar& incB,
+                                       const Kadath::Scalar& incbt,
+                                       const Kadath::Scalar& phi,
+                                       Format format = Format::Indexed,
+                                       double trim_tol = -1) {
+    char* buf = nullptr;
+    size_t size = 0;
+    FILE* f = open_memstream(&buf, &size);
+    if (!f) throw std::runtime_error("Cannot open memory stream");
+    try {
+        write_axisymmetric(f, space, kk, omega, lambda, nu, incA, incB, incbt, phi, format, trim_tol);
+    } catch (...) {
+        fclose(f);
+        free(buf);
+        throw;
+    }
+    bool ok = !ferror(f);
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        free(buf);
+        throw std::runtime_error("Cannot serialize solution to memory");
+    }
+    std::string bytes(buf, size);
+    free(buf);
+    return bytes;
 }
 
 inline void save_spherical(const char* path,
@@ -153,16 +753,24 @@ inline void save_spherical(const char* path,
                            double lambda,
                            const Kadath::Scalar& psi,
                            const Kadath::Scalar& nu,
-                           const Kadath::Scalar& phi) {
-    FILE* f = fopen(path, "w");
-    if (!f) throw std::runtime_error(std::string("Cannot open for write: ") + path);
-    space.save(f);
-    Kadath::fwrite_be(&omega, sizeof(double), 1, f);
-    Kadath::fwrite_be(&lambda, sizeof(double), 1, f);
-    psi.save(f);
-    nu.save(f);
-    phi.save(f);
-    fclose(f);
+                           const Kadath::Scalar& phi,
+                           Format format = Format::Indexed,
+                           double trim_tol = -1) {
+    if (format == Format::Legacy && trim_tol >= 0)
+        throw std::runtime_error("Coefficient trimming needs the indexed format");
+    detail::save_atomic(path, [&](FILE* f) {
+        if (format != Format::Legacy) {
+            write_indexed(f, SolutionKind::Spherical, {"omega", "lambda"}, {omega, lambda}, space, {&psi, &nu, &phi},
+                          trim_tol, format == Format::Native);
+        } else {
+            space.save(f);
+            Kadath::fwrite_be(&omega, sizeof(double), 1, f);
+            Kadath::fwrite_be(&lambda, sizeof(double), 1, f);
+            psi.save(f);
+            nu.save(f);
+            phi.save(f);
+        }
+    });
 }
 
 } // namespace Io
@@ -0,0 +1,268 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Jfnk {
+
+struct Options {
+    int krylov = 40;         // 每个 Newton 步的 GMRES 迭代上限（Krylov 基的大小）
+    double forcing = 1e-2;   // 线性残差相对 |F| 降到此比例即停止（非精确 Newton）
+    double fd_eps = 1e-7;    // 有限差分 Jv 的相对步长
+    int resol_coarse = 9;    // 预条件子所用粗网格的分辨率（由 Axi::Jfnk 使用）
+    double refresh_rate = 0.5;  // 收缩率 |F_k|/|F_{k-1}| 超过此值时重新装配粗网格 Jacobian，否则跨 Newton 步复用
+};
+
+// 上一个 Newton 步中 GMRES 的结果
+enum class Krylov {
+    Converged,   // 线性残差降到 forcing 以下
+    MaxIter,     // 用满 krylov 个方向，修正量已施加但未达 forcing
+    Breakdown    // Hessenberg 对角元为零（预条件子把方向映为零等），未施加修正量
+};
+
+// 场空间中的修正量：与未知量一一对应的场以及标量未知量（如 ome）
+struct Delta {
+    std::vector<Kadath::Scalar> fields;
+    std::vector<double> values;
+};
+
+namespace detail {
+
+inline double maxabs(const Kadath::Scalar& s) {
+    double m = 0;
+    const Kadath::Space& space = s.get_space();
+    for (int d = 0; d < space.get_nbr_domains(); d++) {
+        Kadath::Index idx(space.get_domain(d)->get_nbr_points());
+        do {
+            double v = std::fabs(s(d)(idx));
+            if (std::isfinite(v))
+                m = std::max(m, v);
+        } while (idx.inc());
+    }
+    return m;
+}
+
+inline double maxabs(const Delta& z) {
+    double m = 0;
+    for (const Kadath::Scalar& f : z.fields)
+        m = std::max(m, maxabs(f));
+    for (double v : z.values)
+        m = std::max(m, std::fabs(v));
+    return m;
+}
+
+// y <- y + a x
+inline void axpy(double a, const Delta& x, Delta& y) {
+    for (size_t i = 0; i < y.fields.size(); i++)
+        y.fields[i] = y.fields[i] + a * x.fields[i];
+    for (size_t i = 0; i < y.values.size(); i++)
+        y.values[i] += a * x.values[i];
+}
+
+inline void axpy(double a, const std::vector<Kadath::Scalar>& x, std::vector<Kadath::Scalar>& y) {
+    for (size_t i = 0; i < y.size(); i++)
+        y[i] = y[i] + a * x[i];
+}
+
+inline void scale(double a, std::vector<Kadath::Scalar>& x) {
+    for (Kadath::Scalar& f : x)
+        f = a * f;
+}
+
+} // namespace detail
+
+// 预条件子：输入残差向量 v 及其场表示 r（eq_names 各定义的值，之后是各未知场，即边界条件 field=0 的残差），
+// 输出近似满足 J z = v 的场空间修正量
+using Preconditioner = std::function<void(const std::vector<double>& v, const std::vector<Kadath::Scalar>& r, Delta& z)>;
+
+// Jacobian-free Newton–Krylov：Jv 用残差的有限差分近似，GMRES 在残差空间中迭代，
+// 右预条件后的方向 z 保存在场空间（Kadath 不提供未知量向量与场之间的反向映射），
+// 因此每个 Krylov 向量同时保存其场表示（eq_names 中各定义的值与各未知场）供预条件子使用。
+// 不装配 Jacobian，内存约为 (krylov+1) 份残差向量与场。所有 rank 冗余计算同样的量，
+// 预条件子若含集体通信则需由所有 rank 共同调用。GMRES 中断（见 Krylov::Breakdown）时不施加修正量，
+// 由调用方按 last_krylov() 回退。
+class Engine {
+public:
+    Engine(Kadath::System_of_eqs& syst,
+           const std::vector<Kadath::Scalar*>& fields,
+           const std::vector<double*>& values,
+           const std::vector<std::string>& eq_names,
+           Preconditioner pre,
+           Options opts = Options())
+        : syst_(syst), fields_(fields), values_(values), eq_names_(eq_names),
+          pre_(pre), opts_(opts) {}
+
+    int nbr_krylov() const { return nkrylov_; }
+    Krylov last_krylov() const { return last_; }
+
+    // 与 System_of_eqs::do_newton 相同的约定：返回 true 表示残差已低于 prec
+    bool step(double prec, double& error) {
+        std::vector<double> f;
+        std::vector<Kadath::Scalar> rf;
+        residual(f, rf);
+        int n = int(f.size());
+        error = 0;
+        for (double v : f)
+            error = std::max(error, std::fabs(v));
+        last_ = Krylov::Converged;
+        if (error < prec)
+            return true;
+
+        double beta = norm(f);
+        int m = opts_.krylov;
+        std::vector<std::vector<double>> V(1, f);
+        std::vector<std::vector<Kadath::Scalar>> VR(1, rf);
+        for (double& v : V[0])
+            v /= beta;
+        detail::scale(1.0 / beta, VR[0]);
+
+        std::vector<Delta> Z;
+        std::vector<std::vector<double>> H(m + 1, std::vector<double>(m, 0.0));
+        std::vector<double> cs(m), sn(m), g(m + 1, 0.0);
+        g[0] = beta;
+
+        int k = 0;
+        bool reached = false;
+        for (int j = 0; j < m; j++) {
+            Delta z;
+            pre_(V[j], VR[j], z);
+            std::vector<double> w;
+            std::vector<Kadath::Scalar> wr;
+            apply_jacobian(z, f, rf, w, wr);
+            Z.push_back(z);
+            nkrylov_++;
+
+            // 修正 Gram–Schmidt，场表示同步做相同的线性组合
+            for (int i = 0; i <= j; i++) {
+                double h = dot(w, V[i]);
+                H[i][j] = h;
+                for (int l = 0; l < n; l++)
+                    w[l] -= h * V[i][l];
+                detail::axpy(-h, VR[i], wr);
+            }
+            double hn = norm(w);
+            H[j + 1][j] = hn;
+
+            for (int i = 0; i < j; i++) {
+                double t = cs[i] * H[i][j] + sn[i] * H[i + 1][j];
+                H[i + 1][j] = -sn[i] * H[i][j] + cs[i] * H[i + 1][j];
+                H[i][j] = t;
+            }
+            double r = std::hypot(H[j][j], H[j + 1][j]);
+            cs[j] = (r > 0) ? H[j][j] / r : 1.0;
+            sn[j] = (r > 0) ? H[j + 1][j] / r : 0.0;
+            H[j][j] = r;
+            H[j + 1][j] = 0;
+            g[j + 1] = -sn[j] * g[j];
+            g[j] = cs[j] * g[j];
+            k = j + 1;
+
+            if (r <= 1e-14 * beta) {
+                // 方向在 Jacobian 下映为零：上三角回代会除以零，本步不施加修正量
+                last_ = Krylov::Breakdown;
+                return false;
+            }
+            if (std::fabs(g[j + 1]) <= opts_.forcing * beta || hn == 0) {
+                reached = true;
+                break;
+            }
+            for (double& v : w)
+                v /= hn;
+            detail::scale(1.0 / hn, wr);
+            V.push_back(w);
+            VR.push_back(wr);
+        }
+
+        // 上三角回代得到 y，修正量 s = sum_j y_j z_j，满足 J s ~ F
+        std::vector<double> y(k, 0.0);
+        for (int i = k - 1; i >= 0; i--) {
+            double acc = g[i];
+            for (int l = i + 1; l < k; l++)
+                acc -= H[i][l] * y[l];
+            y[i] = acc / H[i][i];
+            if (!std::isfinite(y[i])) {
+                last_ = Krylov::Breakdown;
+                return false;
+            }
+        }
+        last_ = reached ? Krylov::Converged : Krylov::MaxIter;
+        for (int i = 0; i < k; i++)
+            shift(-y[i], Z[i]);
+        return false;
+    }
+
+private:
+    void residual(std::vector<double>& f, std::vector<Kadath::Scalar>& rf) {
+        syst_.vars_to_terms();
+        Kadath::Array<double> second(syst_.sec_member());
+        f.assign(second.get_data(), second.get_data() + second.get_size(0));
+        rf.clear();
+        for (const std::string& name : eq_names_)
+            rf.emplace_back(Kadath::Scalar(syst_.give_val_def(name.c_str())));
+        for (Kadath::Scalar* s : fields_)
+            rf.push_back(*s);
+    }
+
+    // 未知量 <- 未知量 + a z
+    void shift(double a, const Delta& z) {
+        for (size_t i = 0; i < fields_.size(); i++)
+            *fields_[i] = *fields_[i] + a * z.fields[i];
+        for (size_t i = 0; i < values_.size(); i++)
+            *values_[i] += a * z.values[i];
+    }
+
+    // w = (F(x + eps z) - F(x)) / eps，wr 为其方程场表示
+    void apply_jacobian(const Delta& z, const std::vector<double>& f, const std::vector<Kadath::Scalar>& rf,
+                        std::vector<double>& w, std::vector<Kadath::Scalar>& wr) {
+        double xnorm = 0;
+        for (Kadath::Scalar* s : fields_)
+            xnorm = std::max(xnorm, detail::maxabs(*s));
+        for (double* v : values_)
+            xnorm = std::max(xnorm, std::fabs(*v));
+        double znorm = detail::maxabs(z);
+        double eps = opts_.fd_eps * (1 + xnorm) / (znorm > 0 ? znorm : 1.0);
+
+        std::vector<Kadath::Scalar> saved;
+        for (Kadath::Scalar* s : fields_)
+            saved.push_back(*s);
+        std::vector<double> saved_values;
+        for (double* v : values_)
+            saved_values.push_back(*v);
+
+        shift(eps, z);
+        residual(w, wr);
+        for (size_t i = 0; i < fields_.size(); i++)
+            *fields_[i] = saved[i];
+        for (size_t i = 0; i < values_.size(); i++)
+            *values_[i] = saved_values[i];
+
+        for (size_t l = 0; l < w.size(); l++)
+            w[l] = (w[l] - f[l]) / eps;
+        detail::axpy(-1.0, rf, wr);
+        detail::scale(1.0 / eps, wr);
+    }
+
+    static double dot(const std::vector<double>& a, const std::vector<double>& b) {
+        double s = 0;
+        for (size_t i = 0; i < a.size(); i++)
+            s += a[i] * b[i];
+        return s;
+    }
+
+    static double norm(const std::vector<double>& a) { return std::sqrt(dot(a, a)); }
+
+    Kadath::System_of_eqs& syst_;
+    std::vector<Kadath::Scalar*> fields_;
+    std::vector<double*> values_;
+    std::vector<std::string> eq_names_;
+    Preconditioner pre_;
+    Options opts_;
+    int nkrylov_ = 0;
+    Krylov last_ = Krylov::Converged;
+};
+
+} // namespace Jfnk
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace Manifest {
+
+// 扫描清单的一行：每个求解过的点（含失败的点）一条记录
+struct Entry {
+    std::string scan;        // 扫描标识（msol 中为 "<input_file>:omega" 或 "<input_file>:lambda"）
+    int kk = 0;
+    double omega = 0;
+    double lambda = 0;
+    std::string status;      // Newton::status_name 的结果，"converged" 表示已完成
+    int ite = 0;             // Newton 迭代数（含线搜索阶段）
+    double wall = 0;         // 该点墙钟时间（秒）
+    std::string path;        // 输出文件，失败时为 "-"
+};
+
+static const char* HEADER = "# scan\tkk\tomega\tlambda\tstatus\tite\twall\tpath";
+
+// 只追加的 TSV 清单：每条记录单独打开、写一行并 fsync，被杀死时最多丢掉最后一行。只有 rank 0 写文件。
+class Writer {
+public:
+    Writer(const std::string& path, int rank) : path_(path), rank_(rank) {}
+
+    const std::string& path() const { return path_; }
+
+    void append(const Entry& e) const {
+        if (rank_ != 0 || path_.empty())
+            return;
+        bool fresh = access(path_.c_str(), F_OK) != 0;
+        FILE* f = fopen(path_.c_str(), "a");
+        if (!f)
+            throw std::runtime_error("Manifest: cannot open " + path_);
+        // 任一步失败即抛出（磁盘满等），由调用方的 on_rank0 记为失败，而不是默默丢掉这一行
+        bool ok = !fresh || fprintf(f, "%s\n", HEADER) >= 0;
+        ok = ok && fprintf(f, "%s\t%d\t%.17g\t%.17g\t%s\t%d\t%.3f\t%s\n", e.scan.c_str(), e.kk, e.omega,
+                           e.lambda, e.status.c_str(), e.ite, e.wall, e.path.empty() ? "-" : e.path.c_str()) >= 0;
+        ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+        if (fclose(f) != 0 || !ok)
+            throw std::runtime_error("Manifest: cannot write " + path_);
+    }
+
+private:
+    std::string path_;
+    int rank_;
+};
+
+// 按写入顺序读出全部记录；文件不存在时为空，注释行与不完整的行（如被杀死时写了一半）跳过
+inline std::vector<Entry> read(const std::string& path) {
+    std::vector<Entry> entries;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::vector<std::string> cols;
+        std::stringstream ss(line);
+        std::string col;
+        while (std::getline(ss, col, '\t'))
+            cols.push_back(col);
+        if (cols.size() != 8)
+            continue;
+        Entry e;
+        try {
+            e.scan = cols[0];
+            e.kk = std::stoi(cols[1]);
+            e.omega = std::stod(cols[2]);
+            e.lambda = std::stod(cols[3]);
+            e.status = cols[4];
+            e.ite = std::stoi(cols[5]);
+            e.wall = std::stod(cols[6]);
+            e.path = cols[7] == "-" ? "" : cols[7];
+        } catch (const std::exception&) {
+            continue;
+        }
+        entries.push_back(e);
+    }
+    return entries;
+}
+
+} // namespace Manifest
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Newton {
+
+enum class Status {
+    Converged,
+    MaxIterations,   // 达到迭代上限
+    Stagnated,       // 残差在 stagnation_window 步内下降不足
+    Diverged,        // 残差超过历史最小值的 blowup_factor 倍
+    NonFinite,       // 残差为 NaN / inf
+    Interrupted      // Options::stop 请求中断（如收到 SIGTERM）
+};
+
+inline const char* status_name(Status s) {
+    switch (s) {
+    case Status::Converged: return "converged";
+    case Status::MaxIterations: return "max_iterations";
+    case Status::Stagnated: return "stagnated";
+    case Status::Diverged: return "diverged";
+    case Status::NonFinite: return "non_finite";
+    case Status::Interrupted: return "interrupted";
+    }
+    return "unknown";
+}
+
+struct Options {
+    double prec = 1e-8;
+    int max_ite = 30;              // 常规 Newton 迭代上限
+    int stagnation_window = 6;     // 停滞检测窗口
+    double stagnation_ratio = 0.9; // 窗口内残差至少降到此比例，否则视为停滞
+    double blowup_factor = 1e2;    // 残差超过历史最小值的此倍数视为发散
+    bool linesearch = true;        // 失败后回到初值改用带线搜索的阻尼 Newton
+    int linesearch_ite = 20;       // 线搜索阶段迭代上限
+    int linesearch_ntry = 10;      // 每步回溯次数（do_newton_with_linesearch 的 ntrymax）
+    double linesearch_step = 0.5;  // 最大步长（stepmax）
+    std::function<bool()> stop;    // 每步后调用（所有 rank），返回 true 时中断
+    // 续算：本次求解此前各步的残差；已进入线搜索阶段时给出该阶段在其中的起始下标
+    std::vector<double> resume_history;
+    int resume_linesearch_from = -1;
+};
+
+struct Report {
+    Status status = Status::MaxIterations;
+    Status first_status = Status::MaxIterations;  // 常规 Newton 阶段的结果
+    bool used_linesearch = false;
+    int linesearch_from = -1;      // 线搜索阶段在 history 中的起始下标
+    int ite = 0;                   // 两阶段总迭代数
+    double conv = 0;
+    double rate = 1;               // 最后一步的收缩率 |F_k|/|F_{k-1}|
+    std::vector<double> history;
+
+    bool converged() const { return status == Status::Converged; }
+};
+
+// 初值快照：失败后恢复未知量，供线搜索阶段从同一初值重新开始
+class Snapshot {
+public:
+    Snapshot(const std::vector<Kadath::Scalar*>& fields, const std::vector<double*>& values = {})
+        : fields_(fields), values_(values) {
+        for (Kadath::Scalar* f : fields_)
+            saved_fields_.emplace_back(new Kadath::Scalar(*f));
+        for (double* v : values_)
+            saved_values_.push_back(*v);
+    }
+
+    void restore() const {
+        for (size_t i = 0; i < fields_.size(); i++)
+            *fields_[i] = *saved_fields_[i];
+        for (size_t i = 0; i < values_.size(); i++)
+            *values_[i] = saved_values_[i];
+    }
+
+private:
+    std::vector<Kadath::Scalar*> fields_;
+    std::vector<double*> values_;
+    std::vector<std::unique_ptr<Kadath::Scalar>> saved_fields_;
+    std::vector<double> saved_values_;
+};
+
+using Step = std::function<bool(double prec, double& conv)>;
+using Linesearch = std::function<bool(double prec, double& conv, int ntry, double stepmax)>;
+using Monitor = std::function<void(int ite, double conv, bool linesearch)>;
+
+namespace detail {
+
+inline Status iterate(const Options& opts, int max_ite, bool ls,
+                      const std::function<bool(double&)>& one_step,
+                      const Monitor& monitor, Report& rep,
+                      std::vector<double> hist = {}) {
+    double conv_min = -1;
+    for (double h : hist)
+        if (conv_min < 0 || h < conv_min)
+            conv_min = h;
+    for (int k = int(hist.size()) + 1; k <= max_ite; k++) {
+        double conv = 0;
+        bool done = one_step(conv);
+        rep.ite++;
+        if (!hist.empty() && hist.back() > 0)
+            rep.rate = conv / hist.back();
+        rep.conv = conv;
+        rep.history.push_back(conv);
+        hist.push_back(conv);
+        if (monitor)
+            monitor(rep.ite, conv, ls);
+        if (done)
+            return Status::Converged;
+        if (opts.stop && opts.stop())
+            return Status::Interrupted;
+        if (!std::isfinite(conv))
+            return Status::NonFinite;
+        if (conv_min < 0 || conv < conv_min)
+            conv_min = conv;
+        if (conv > opts.blowup_factor * conv_min)
+            return Status::Diverged;
+        int w = opts.stagnation_window;
+        if (w > 0 && int(hist.size()) > w && conv > opts.stagnation_ratio * hist[hist.size() - 1 - w])
+            return Status::Stagnated;
+    }
+    return Status::MaxIterations;
+}
+
+} // namespace detail
+
+// 受监控的 Newton 求解：常规步（do_newton 或弦方法）失败时恢复快照，
+// 再以 do_newton_with_linesearch 的阻尼步重试。所有 rank 的残差相同，判据在各 rank 一致。
+inline Report run(const Options& opts, const Step& step, const Linesearch& linesearch,
+                  const Snapshot* snapshot = nullptr, const Monitor& monitor = Monitor()) {
+    Report rep;
+    rep.history = opts.resume_history;
+    rep.ite = int(rep.history.size());
+    int ls_from = opts.resume_linesearch_from;
+    if (ls_from < 0) {
+        rep.status = detail::iterate(opts, opts.max_ite, false,
+                                     [&](double& conv) { return step(opts.prec, conv); }, monitor, rep,
+                                     rep.history);
+        rep.first_status = rep.status;
+        if (rep.converged() || rep.status == Status::Interrupted || !opts.linesearch || !linesearch)
+            return rep;
+        if (snapshot)
+            snapshot->restore();
+        ls_from = int(rep.history.size());
+    }
+
+    rep.used_linesearch = true;
+    rep.linesearch_from = ls_from;
+    rep.status = detail::iterate(opts, opts.linesearch_ite, true,
+                                 [&](double& conv) {
+                                     return linesearch(opts.prec, conv, opts.linesearch_ntry, opts.linesearch_step);
+                                 },
+                                 monitor, rep,
+                                 std::vector<double>(rep.history.begin() + ls_from, rep.history.end()));
+    return rep;
+}
+
+// 直接驱动一个 System_of_eqs
+inline Report run(const Options& opts, Kadath::System_of_eqs& syst,
+                  const Snapshot* snapshot = nullptr, const Monitor& monitor = Monitor()) {
+    return run(opts,
+               [&](double prec, double& conv) { return syst.do_newton(prec, conv); },
+               [&](double prec, double& conv, int ntry, double stepmax) {
+                   return syst.do_newton_with_linesearch(prec, conv, ntry, stepmax);
+               },
+               snapshot, monitor);
+}
+
+} // namespace Newton
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include "utils/io_commons.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Observables {
+
+// 一个解的全局量；球对称解没有角动量，Js/Jv 为 NaN
+struct Values {
+    Io::SolutionKind kind = Io::SolutionKind::Axisymmetric;
+    int kk = 0;
+    double omega = 0;
+    double lambda = 0;
+    bool has_lambda = true;
+    double Madm = 0;
+    double Mkomar = 0;
+    double Js = std::numeric_limits<double>::quiet_NaN();
+    double Jv = std::numeric_limits<double>::quiet_NaN();
+
+    double diff_mass() const { return std::fabs(Madm - Mkomar) / std::fabs(Madm + Mkomar); }
+    double diff_j() const { return std::fabs(Js - Jv) / std::fabs(Js + Jv); }
+};
+
+// 轴对称：由求解变量 (nu, incA, incB, incbt, phi) 重建 ap、A、B、bt 后求 ADM/Komar 质量与两种角动量
+inline Values axisymmetric(const Kadath::Space_polar& space, int kk, double omega, double lambda,
+                           const Kadath::Scalar& nu, const Kadath::Scalar& incA, const Kadath::Scalar& incB,
+                           const Kadath::Scalar& incbt, const Kadath::Scalar& phi) {
+    using namespace Kadath;
+    Scalar ap(exp(nu));
+    ap.std_base();
+    Scalar A(exp(incA - nu));
+    A.std_base();
+    Scalar B((incB.div_rsint() + 1) / ap);
+    B.std_base();
+    Scalar bt(incbt.div_rsint());
+    bt.std_base();
+
+    int ndom = space.get_nbr_domains();
+    Values v;
+    v.kind = Io::SolutionKind::Axisymmetric;
+    v.kk = kk;
+    v.omega = omega;
+    v.lambda = lambda;
+
+    Val_domain integadm(A(ndom - 1).der_r());
+    v.Madm = -space.get_domain(ndom - 1)->integ(integadm, OUTER_BC) / 4 / M_PI;
+
+    Val_domain integkomar(ap(ndom - 1).der_r());
+    v.Mkomar = space.get_domain(ndom - 1)->integ(integkomar, OUTER_BC) / 4 / M_PI;
+
+    Val_domain auxiJs(bt(ndom - 1).der_r_rtwo());
+    Val_domain integJs(auxiJs.mult_sin_theta().mult_sin_theta());
+    v.Js = -space.get_domain(ndom - 1)->integ(integJs, OUTER_BC) / 16 / M_PI;
+
+    Scalar auxiJv(kk * (omega - bt * kk) * phi * phi / ap * A * A * B);
+    Scalar integJv(space);
+    for (int d = 0; d < ndom; d++)
+        integJv.set_domain(d) = auxiJv(d).mult_r().mult_sin_theta();
+    v.Jv = 0;
+    for (int d = 0; d < ndom; d++)
+        v.Jv += space.get_domain(d)->integ_volume(integJv(d));
+    v.Jv *= 2 * M_PI;
+    return v;
+}
+
+// 球对称：Psi = exp(psi)、N = exp(nu)，A = Psi^4
+inline Values spherical(const Kadath::Space_polar& space, double omega, double lambda,
+                        const Kadath::Scalar& psi, const Kadath::Scalar& nu) {
+    using namespace Kadath;
+    Scalar Psi(exp(psi));
+    Psi.std_base();
+    Scalar N(exp(nu));
+    N.std_base();
+    Scalar A(Psi * Psi * Psi * Psi);
+    A.std_base();
+
+    int ndom = space.get_nbr_domains();
+    Values v;
+    v.kind = Io::SolutionKind::Spherical;
+    v.kk = 0;
+    v.omega = omega;
+    v.lambda = lambda;
+
+    Val_domain integadm(A(ndom - 1).der_r());
+    v.Madm = -space.get_domain(ndom - 1)->integ(integadm, OUTER_BC) / 4 / M_PI;
+
+    Val_domain integkomar(N(ndom - 1).der_r());
+    v.Mkomar = space.get_domain(ndom - 1)->integ(integkomar, OUTER_BC) / 4 / M_PI;
+    return v;
+}
+
+inline Values compute(const Io::Solution& sol) {
+    Values v;
+    if (sol.kind == Io::SolutionKind::Axisymmetric)
+        v = axisymmetric(*sol.space, sol.kk, sol.omega, sol.lambda, sol.field("nu"), sol.field("incA"),
+                         sol.field("incB"), sol.field("incbt"), sol.field("phi"));
+    else
+        v = spherical(*sol.space, sol.omega, sol.lambda, sol.field("psi"), sol.field("nu"));
+    v.has_lambda = sol.has_lambda;
+    return v;
+}
+
+// 计算结果缓存：键为 FNV-1a(文件内容) 与物理量集合、公式版本的组合，每个键一个小文本文件。
+// 内容寻址，文件被改写或改名都不会取到旧值；修改上面的公式时须递增 CODE_VERSION。
+// 写入经临时文件加 rename，多个进程共用同一缓存目录是安全的。
+static const char* QUANTITIES = "Madm,Mkomar,Js,Jv";
+static constexpr int CODE_VERSION = 1;
+
+class Cache {
+public:
+    explicit Cache(const std::string& dir) : dir_(dir) {
+        // 逐级创建；建不了时缓存只是一直不命中
+        for (size_t pos = 1; pos <= dir_.size(); pos++)
+            if (pos == dir_.size() || dir_[pos] == '/')
+                mkdir(dir_.substr(0, pos).c_str(), 0755);
+    }
+
+    // $BS_READER_CACHE，否则 $XDG_CACHE_HOME/bs_reader 或 ~/.cache/bs_reader
+    static std::string default_dir() {
+        if (const char* d = std::getenv("BS_READER_CACHE"))
+            return d;
+        if (const char* d = std::getenv("XDG_CACHE_HOME"))
+            return std::string(d) + "/bs_reader";
+        if (const char* d = std::getenv("HOME"))
+            return std::string(d) + "/.cache/bs_reader";
+        return ".bs_reader_cache";
+    }
+
+    static std::uint64_t fnv1a(const void* data, size_t n, std::uint64_t h = 14695981039346656037ull) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < n; i++) {
+            h ^= p[i];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    // 读一遍文件内容算键（不反序列化任何 Kadath 对象）
+    static std::string key(const char* path) {
+        FILE* f = fopen(path, "rb");
+        if (!f)
+            throw std::runtime_error(std::string("Cannot open file: ") + path);
+        std::uint64_t h = 14695981039346656037ull;
+        std::vector<char> buf(1 << 20);
+        size_t n;
+        while ((n = fread(buf.data(), 1, buf.size(), f)) > 0)
+            h = fnv1a(buf.data(), n, h);
+        fclose(f);
+        std::string tag = std::string(QUANTITIES) + "#" + std::to_string(CODE_VERSION);
+        h = fnv1a(tag.data(), tag.size(), h);
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)h);
+        return hex;
+    }
+
+    bool load(const std::string& key, Values& v) const {
+        FILE* f = fopen(entry(key).c_str(), "r");
+        if (!f)
+            return false;
+        int kind = 0;
+        int has_lambda = 0;
+        char num[6][64];
+        bool ok = fscanf(f, "%d %d %d %63s %63s %63s %63s %63s %63s", &kind, &v.kk, &has_lambda, num[0], num[1],
+                         num[2], num[3], num[4], num[5]) == 9;
+        fclose(f);
+        if (!ok)
+            return false;
+        v.kind = kind == 0 ? Io::SolutionKind::Axisymmetric : Io::SolutionKind::Spherical;
+        v.has_lambda = has_lambda != 0;
+        double* out[6] = {&v.omega, &v.lambda, &v.Madm, &v.Mkomar, &v.Js, &v.Jv};
+        for (int i = 0; i < 6; i++)
+            *out[i] = std::strtod(num[i], nullptr);
+        return true;
+    }
+
+    void store(const std::string& key, const Values& v) const {
+        std::string path = entry(key);
+        std::string tmp = path + ".tmp" + std::to_string(getpid());
+        FILE* f = fopen(tmp.c_str(), "w");
+        if (!f)
+            return;   // 缓存只是加速，写不了就算了
+        fprintf(f, "%d %d %d %.17g %.17g %.17g %.17g %.17g %.17g\n", v.kind == Io::SolutionKind::Axisymmetric ? 0 : 1,
+                v.kk, v.has_lambda ? 1 : 0, v.omega, v.lambda, v.Madm, v.Mkomar, v.Js, v.Jv);
+        bool ok = fclose(f) == 0;
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+            unlink(tmp.c_str());
+    }
+
+    // 命中则不读任何场，否则读入、计算并写回缓存
+    Values get(const char* path, bool* hit = nullptr) const {
+        std::string k = key(path);
+        Values v;
+        bool found = load(k, v);
+        if (hit)
+            *hit = found;
+        if (found)
+            return v;
+        Io::Solution sol = Io::read_solution(path);
+        v = compute(sol);
+        store(k, v);
+        return v;
+    }
+
+private:
+    std::string entry(const std::string& key) const { return dir_ + "/" + key + ".obs"; }
+
+    std::string dir_;
+};
+
+// 扫描中逐点追加的结果表（CSV）：求解器在收敛后直接由内存中的场计算上面的量，无需事后再用 reader 读回。
+// 每行单独打开、写入并关闭，扫描进行中即可读取作图；只有 rank 0 写文件，path 为空时关闭。
+static const char* TABLE_HEADER = "scan,kk,omega,lambda,Madm,Mkomar,Js,Jv,diff_mass,diff_j,ite,wall,path";
+
+class Table {
+public:
+    Table(const std::string& path, int rank) : path_(path), rank_(rank) {}
+
+    bool enabled() const { return rank_ == 0 && !path_.empty(); }
+
+    void append(const std::string& scan, const Values& v, int ite, double wall, const std::string& file) const {
+        if (!enabled())
+            return;
+        bool fresh = access(path_.c_str(), F_OK) != 0;
+        FILE* f = fopen(path_.c_str(), "a");
+        if (!f)
+            throw std::runtime_error("Observables: cannot open " + path_);
+        bool ok = !fresh || fprintf(f, "%s\n", TABLE_HEADER) >= 0;
+        ok = ok && fprintf(f, "%s,%d,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%d,%.6g,%s\n", scan.c_str(), v.kk,
+                           v.omega, v.lambda, v.Madm, v.Mkomar, v.Js, v.Jv, v.diff_mass(),
+                           v.kind == Io::SolutionKind::Axisymmetric ? v.diff_j() : std::nan(""), ite, wall,
+                           file.empty() ? "-" : file.c_str()) >= 0;
+        if (fclose(f) != 0 || !ok)
+            throw std::runtime_error("Observables: cannot write " + path_);
+    }
+
+private:
+    std::string path_;
+    int rank_;
+};
+
+} // namespace Observables
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace Cont {
+
+// 延拓预测器：保存最近 order+1 个收敛解（场与标量参数），
+// 用 Lagrange 多项式外推到新的参数值作为 Newton 初值；点数不足时自动降阶。
+class Predictor {
+public:
+    explicit Predictor(int order) : order_(order < 0 ? 0 : order) {}
+
+    int order() const { return order_; }
+    int size() const { return int(history_.size()); }
+    void clear() { history_.clear(); }
+
+    void push(double s,
+              const std::vector<const Kadath::Scalar*>& fields,
+              const std::vector<double>& values = {}) {
+        if (!history_.empty() && history_.back().s == s)
+            history_.pop_back();
+        Entry e;
+        e.s = s;
+        for (const Kadath::Scalar* f : fields)
+            e.fields.emplace_back(new Kadath::Scalar(*f));
+        e.values = values;
+        history_.push_back(std::move(e));
+        while (int(history_.size()) > order_ + 1)
+            history_.pop_front();
+    }
+
+    void predict(double s,
+                 const std::vector<Kadath::Scalar*>& fields,
+                 const std::vector<double*>& values = {}) const {
+        if (history_.empty())
+            return;
+        const Entry& last = history_.back();
+        if (fields.size() != last.fields.size() || values.size() > last.values.size())
+            throw std::runtime_error("Predictor: field count mismatch");
+
+        int n = int(history_.size());
+        std::vector<double> w(n, 1.0);
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < n; j++)
+                if (j != i)
+                    w[i] *= (s - history_[j].s) / (history_[i].s - history_[j].s);
+
+        for (size_t k = 0; k < fields.size(); k++) {
+            Kadath::Scalar acc(w[0] * (*history_[0].fields[k]));
+            for (int i = 1; i < n; i++)
+                acc = acc + w[i] * (*history_[i].fields[k]);
+            *fields[k] = acc;
+        }
+        for (size_t k = 0; k < values.size(); k++) {
+            double acc = 0;
+            for (int i = 0; i < n; i++)
+                acc += w[i] * history_[i].values[k];
+            *values[k] = acc;
+        }
+    }
+
+private:
+    struct Entry {
+        double s;
+        std::vector<std::unique_ptr<Kadath::Scalar>> fields;
+        std::vector<double> values;
+    };
+
+    int order_;
+    std::deque<Entry> history_;
+};
+
+} // namespace Cont
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <string>
+
+namespace Regrid {
+
+// 紧致域中 r=inf 的配置点改用该半径求值，源场在此处已等于无穷远值（相对误差 ~1/r）
+static constexpr double R_INF = 1e12;
+
+// 把 src 谱插值到 like 所在空间：在目标配置点上逐点谱求和，基底与参数取自 like。
+// 源与目标的 resol / ndom / bounds 可以任意不同。
+inline Kadath::Scalar transfer(const Kadath::Scalar& src, const Kadath::Scalar& like) {
+    const Kadath::Space& target = like.get_space();
+    Kadath::Scalar res(like);
+    int ndom = target.get_nbr_domains();
+    for (int d = 0; d < ndom; d++) {
+        const Kadath::Domain* dom = target.get_domain(d);
+        const Kadath::Val_domain& xx = dom->get_cart(1);
+        const Kadath::Val_domain& zz = dom->get_cart(2);
+        const Kadath::Val_domain& rr = dom->get_radius();
+        res.set_domain(d).annule_hard();
+        Kadath::Index idx(dom->get_nbr_points());
+        do {
+            Kadath::Point p(2);
+            double r = rr(idx);
+            if (std::isfinite(r)) {
+                p.set(1) = xx(idx);
+                p.set(2) = zz(idx);
+            } else {
+                // 取同一 theta 上该域内边界点的方向
+                Kadath::Index inner(idx);
+                inner.set(0) = 0;
+                double r0 = rr(inner);
+                p.set(1) = xx(inner) / r0 * R_INF;
+                p.set(2) = zz(inner) / r0 * R_INF;
+            }
+            res.set_domain(d).set(idx) = src.val_point(p);
+        } while (idx.inc());
+    }
+    return res;
+}
+
+// 标准基底的零场模板；m_quant >= 0 时附带 m 量子数（用于 phi）
+inline Kadath::Scalar std_like(const Kadath::Space& space, int m_quant = -1) {
+    Kadath::Scalar like(space);
+    like.annule_hard();
+    if (m_quant >= 0) {
+        Kadath::Param_tensor parameters;
+        parameters.set_m_quant() = m_quant;
+        like.set_parameters() = parameters;
+    }
+    like.std_base();
+    return like;
+}
+
+// 与 space 相同区域划分、径向（及非球对称时角向）分辨率改为 resol 的新空间；
+// 边界取自各有限域配置点的最大半径
+inline std::unique_ptr<Kadath::Space_polar> with_resol(const Kadath::Space_polar& space, int resol) {
+    int ndom = space.get_nbr_domains();
+    Kadath::Array<double> bounds(ndom - 1);
+    for (int d = 0; d < ndom - 1; d++) {
+        const Kadath::Domain* dom = space.get_domain(d);
+        const Kadath::Val_domain& rr = dom->get_radius();
+        double rmax = 0;
+        Kadath::Index idx(dom->get_nbr_points());
+        do {
+            rmax = std::max(rmax, rr(idx));
+        } while (idx.inc());
+        bounds.set(d) = rmax;
+    }
+    Kadath::Dim_array res(2);
+    res.set(0) = resol;
+    res.set(1) = (space.get_domain(0)->get_nbr_points()(1) > 1) ? resol : 1;
+    Kadath::Point center(2);
+    center.set(1) = 0;
+    center.set(2) = 0;
+    return std::unique_ptr<Kadath::Space_polar>(new Kadath::Space_polar(CHEB_TYPE, center, res, bounds));
+}
+
+// 网格键：分辨率、角向是否退化、各有限域的外边界（与 with_resol 取边界的方式一致）；
+// 键相同的两个空间上的场可以逐系数对应
+inline std::string grid_key(const Kadath::Space_polar& space, int resol = -1) {
+    if (resol < 0)
+        resol = space.get_domain(0)->get_nbr_points()(0);
+    std::ostringstream key;
+    key << resol << (space.get_domain(0)->get_nbr_points()(1) > 1 ? "" : "s");
+    for (int d = 0; d < space.get_nbr_domains() - 1; d++) {
+        const Kadath::Val_domain& rr = space.get_domain(d)->get_radius();
+        double rmax = 0;
+        Kadath::Index idx(space.get_domain(d)->get_nbr_points());
+        do {
+            rmax = std::max(rmax, rr(idx));
+        } while (idx.inc());
+        char b[32];
+        std::snprintf(b, sizeof(b), "/%.12g", rmax);
+        key << b;
+    }
+    return key.str();
+}
+
+} // namespace Regrid
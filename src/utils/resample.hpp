@@ -0,0 +1,318 @@
+#pragma once
+
+#include "kadath_polar.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace Resample {
+
+// 均匀目标网格：极坐标 (r, theta) 或笛卡尔 (x, z)，第一维为行
+struct Grid {
+    bool cartesian = false;
+    int n1 = 0;              // r 或 x 的点数
+    double a0 = 0, a1 = 0;
+    int n2 = 0;              // theta 或 z 的点数
+    double b0 = 0, b1 = 0;
+
+    double u(int i) const { return n1 > 1 ? a0 + (a1 - a0) * i / (n1 - 1) : a0; }
+    double v(int j) const { return n2 > 1 ? b0 + (b1 - b0) * j / (n2 - 1) : b0; }
+
+    void polar(int i, int j, double& r, double& theta) const {
+        if (cartesian) {
+            r = std::hypot(u(i), v(j));
+            theta = std::atan2(u(i), v(j));
+        } else {
+            r = u(i);
+            theta = v(j);
+        }
+    }
+};
+
+namespace detail {
+
+// 一维基函数族：径向 T_i / T_2i / T_2i+1（x 为域内数值坐标），角向 cos/sin 的 j、2j、2j+1 倍角
+enum Radial { T_N, T_2N, T_2N1, N_RADIAL };
+enum Angular { COS_N, SIN_N, COS_2N, SIN_2N, COS_2N1, SIN_2N1, N_ANGULAR };
+
+inline int radial_order(int fam, int i) { return fam == T_N ? i : (fam == T_2N ? 2 * i : 2 * i + 1); }
+inline int angular_order(int fam, int j) { return (fam == COS_N || fam == SIN_N) ? j : (fam == COS_2N || fam == SIN_2N) ? 2 * j : 2 * j + 1; }
+inline bool angular_sin(int fam) { return fam == SIN_N || fam == SIN_2N || fam == SIN_2N1; }
+
+inline double cheb(int n, double x) {
+    if (std::fabs(x) <= 1)
+        return std::cos(n * std::acos(x));
+    double t0 = 1, t1 = x;
+    if (n == 0)
+        return t0;
+    for (int k = 1; k < n; k++) {
+        double t2 = 2 * x * t1 - t0;
+        t0 = t1;
+        t1 = t2;
+    }
+    return t1;
+}
+
+// 极坐标域的径向映射：0 核（r = R x），1 壳（r = a x + b），2 紧致域（1/r = (x - 1) / (-2 R_in)）
+struct Domain_map {
+    int type = 1;
+    double r0 = 0;
+    double r1 = 0;
+
+    double x(double r) const {
+        if (type == 0)
+            return r / r1;
+        if (type == 1)
+            return (2 * r - r0 - r1) / (r1 - r0);
+        return 1 - 2 * r0 / r;
+    }
+};
+
+struct Column {
+    bool zero = true;
+    int rad = T_N;
+    int ang = COS_N;
+    double scale = 1;    // Kadath 的基函数与上述族之间可能相差的常数因子
+};
+
+// 一个场在一个域上的系数与各列（角向下标 j）的基函数族；fast 为 false 时该部分退回 Kadath 逐点求值
+struct Part {
+    bool zero = true;
+    bool fast = true;
+    int nr = 0;
+    int nt = 0;
+    std::vector<double> c;   // c[j * nr + i]
+    std::vector<Column> cols;
+};
+
+// 以单位系数场在三个域内探测点上的值识别第 j 列的基函数族（Kadath 调用，须串行）
+inline Column identify(const Kadath::Scalar& s, int d, int j, int nr, const Domain_map& m) {
+    const Kadath::Space& space = s.get_space();
+    Kadath::Scalar unit(space);
+    unit.annule_hard();
+    Kadath::Val_domain& uv = unit.set_domain(d);
+    uv.set_in_coef();
+    uv.set_base() = s(d).get_base();
+    int ip = nr > 1 ? 1 : 0;
+    Kadath::Index idx(space.get_domain(d)->get_nbr_coefs());
+    do {
+        uv.set_coef(idx) = (idx(0) == ip && idx(1) == j) ? 1.0 : 0.0;
+    } while (idx.inc());
+
+    const double fr[3] = {0.31, 0.57, 0.83};
+    const double th[3] = {0.37, 0.81, 1.23};
+    double r[3], x[3], val[3];
+    for (int k = 0; k < 3; k++) {
+        r[k] = m.type == 2 ? m.r0 / (1 - 0.9 * fr[k]) : m.r0 + (m.r1 - m.r0) * fr[k];
+        x[k] = m.x(r[k]);
+        Kadath::Point p(2);
+        p.set(1) = r[k] * std::sin(th[k]);
+        p.set(2) = r[k] * std::cos(th[k]);
+        val[k] = unit.val_point(p);
+    }
+
+    Column col;
+    double vmax = std::max(std::fabs(val[0]), std::max(std::fabs(val[1]), std::fabs(val[2])));
+    if (vmax < 1e-300) {
+        col.zero = true;
+        return col;
+    }
+    for (int rf = 0; rf < N_RADIAL; rf++)
+        for (int af = 0; af < N_ANGULAR; af++) {
+            double pred[3];
+            int kmax = 0;
+            for (int k = 0; k < 3; k++) {
+                int na = angular_order(af, j);
+                double a = angular_sin(af) ? std::sin(na * th[k]) : std::cos(na * th[k]);
+                pred[k] = cheb(radial_order(rf, ip), x[k]) * a;
+                if (std::fabs(pred[k]) > std::fabs(pred[kmax]))
+                    kmax = k;
+            }
+            if (std::fabs(pred[kmax]) < 1e-12)
+                continue;
+            double scale = val[kmax] / pred[kmax];
+            bool ok = true;
+            for (int k = 0; k < 3 && ok; k++)
+                ok = std::fabs(val[k] - scale * pred[k]) <= 1e-9 * (1 + vmax);
+            if (ok) {
+                col.zero = false;
+                col.rad = rf;
+                col.ang = af;
+                col.scale = scale;
+                return col;
+            }
+        }
+    throw std::runtime_error("unidentified");
+}
+
+inline Part analyse(const Kadath::Scalar& s, int d, const Domain_map& m) {
+    Part part;
+    const Kadath::Val_domain& v = s(d);
+    if (v.check_if_zero())
+        return part;
+    part.zero = false;
+    Kadath::Dim_array dims(s.get_space().get_domain(d)->get_nbr_coefs());
+    part.nr = dims(0);
+    part.nt = dims.get_ndim() > 1 ? dims(1) : 1;
+    part.c.assign(size_t(part.nr) * part.nt, 0.0);
+    v.coef();
+    Kadath::Index idx(dims);
+    do {
+        part.c[size_t(idx(1)) * part.nr + idx(0)] = v.get_coef()(idx);
+    } while (idx.inc());
+    try {
+        for (int j = 0; j < part.nt; j++)
+            part.cols.push_back(identify(s, d, j, part.nr, m));
+    } catch (const std::runtime_error&) {
+        part.fast = false;
+        part.cols.clear();
+    }
+    return part;
+}
+
+// 一个点上全部场的求和：Chebyshev 递推与倍角递推只算一次，各场共用
+inline void evaluate(const std::vector<const Part*>& parts, double x, double theta,
+                     std::vector<double>& T, std::vector<double>& C, std::vector<double>& S, double* out) {
+    size_t nT = T.size();
+    T[0] = 1;
+    if (nT > 1)
+        T[1] = x;
+    for (size_t n = 2; n < nT; n++)
+        T[n] = 2 * x * T[n - 1] - T[n - 2];
+    double c1 = std::cos(theta);
+    double s1 = std::sin(theta);
+    C[0] = 1;
+    S[0] = 0;
+    for (size_t n = 1; n < C.size(); n++) {
+        C[n] = C[n - 1] * c1 - S[n - 1] * s1;
+        S[n] = S[n - 1] * c1 + C[n - 1] * s1;
+    }
+    for (size_t f = 0; f < parts.size(); f++) {
+        const Part& p = *parts[f];
+        if (p.zero || !p.fast)
+            continue;
+        double sum = 0;
+        for (int j = 0; j < p.nt; j++) {
+            const Column& col = p.cols[j];
+            if (col.zero)
+                continue;
+            const double* cj = &p.c[size_t(j) * p.nr];
+            double rs = 0;
+            switch (col.rad) {
+            case T_N:
+                for (int i = 0; i < p.nr; i++)
+                    rs += cj[i] * T[i];
+                break;
+            case T_2N:
+                for (int i = 0; i < p.nr; i++)
+                    rs += cj[i] * T[2 * i];
+                break;
+            default:
+                for (int i = 0; i < p.nr; i++)
+                    rs += cj[i] * T[2 * i + 1];
+                break;
+            }
+            int na = angular_order(col.ang, j);
+            sum += col.scale * rs * (angular_sin(col.ang) ? S[na] : C[na]);
+        }
+        out[f] = sum;
+    }
+}
+
+} // namespace detail
+
+// 把各场重采样到 grid 上，结果 out[f][i * n2 + j]（行优先，连续）。
+// 准备阶段（提取系数、识别基函数族）串行调用 Kadath；求和在 nthreads 个线程上按行并行，不再调用 Kadath。
+// 无法识别基函数族的 (场, 域) 退回串行的 Scalar::val_point。
+inline std::vector<std::vector<double>> run(const Kadath::Space_polar& space,
+                                            const std::vector<const Kadath::Scalar*>& fields,
+                                            const Grid& grid, int nthreads = 0) {
+    int ndom = space.get_nbr_domains();
+    std::vector<detail::Domain_map> maps(ndom);
+    for (int d = 0; d < ndom; d++) {
+        const Kadath::Domain* dom = space.get_domain(d);
+        const Kadath::Val_domain& rr = dom->get_radius();
+        double rmax = 0;
+        Kadath::Index idx(dom->get_nbr_points());
+        do {
+            double r = rr(idx);
+            if (std::isfinite(r))
+                rmax = std::max(rmax, r);
+        } while (idx.inc());
+        maps[d].type = d == 0 ? 0 : (d == ndom - 1 ? 2 : 1);
+        maps[d].r0 = d == 0 ? 0 : maps[d - 1].r1;
+        maps[d].r1 = d == ndom - 1 ? std::numeric_limits<double>::infinity() : rmax;
+    }
+
+    size_t nf = fields.size();
+    std::vector<std::vector<detail::Part>> parts(ndom, std::vector<detail::Part>(nf));
+    std::vector<std::vector<const detail::Part*>> dparts(ndom);
+    size_t nT = 2;
+    size_t nC = 2;
+    bool need_fallback = false;
+    for (int d = 0; d < ndom; d++)
+        for (size_t f = 0; f < nf; f++) {
+            parts[d][f] = detail::analyse(*fields[f], d, maps[d]);
+            dparts[d].push_back(&parts[d][f]);
+            nT = std::max(nT, size_t(2 * parts[d][f].nr + 2));
+            nC = std::max(nC, size_t(2 * parts[d][f].nt + 2));
+            need_fallback = need_fallback || (!parts[d][f].zero && !parts[d][f].fast);
+        }
+
+    auto domain_of = [&](double r) {
+        for (int d = 0; d < ndom - 1; d++)
+            if (r <= maps[d].r1)
+                return d;
+        return ndom - 1;
+    };
+
+    std::vector<std::vector<double>> out(nf, std::vector<double>(size_t(grid.n1) * grid.n2, 0.0));
+    if (nthreads <= 0)
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+    std::atomic<int> next_row(0);
+    auto worker = [&]() {
+        std::vector<double> T(nT), C(nC), S(nC), vals(nf);
+        int i;
+        while ((i = next_row++) < grid.n1) {
+            for (int j = 0; j < grid.n2; j++) {
+                double r, theta;
+                grid.polar(i, j, r, theta);
+                int d = domain_of(r);
+                std::fill(vals.begin(), vals.end(), 0.0);
+                detail::evaluate(dparts[d], maps[d].x(r), theta, T, C, S, vals.data());
+                for (size_t f = 0; f < nf; f++)
+                    out[f][size_t(i) * grid.n2 + j] = vals[f];
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < nthreads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool)
+        t.join();
+
+    if (need_fallback) {
+        for (int i = 0; i < grid.n1; i++)
+            for (int j = 0; j < grid.n2; j++) {
+                double r, theta;
+                grid.polar(i, j, r, theta);
+                int d = domain_of(r);
+                for (size_t f = 0; f < nf; f++) {
+                    if (parts[d][f].zero || parts[d][f].fast)
+                        continue;
+                    Kadath::Point p(2);
+                    p.set(1) = r * std::sin(theta);
+                    p.set(2) = r * std::cos(theta);
+                    out[f][size_t(i) * grid.n2 + j] = fields[f]->val_point(p);
+                }
+            }
+    }
+    return out;
+}
+
+} // namespace Resample